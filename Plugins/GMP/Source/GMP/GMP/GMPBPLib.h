@@ -159,15 +159,15 @@ public:
 
 	static bool CallEventFunction(UObject* Obj, const FName FuncName, const TArray<uint8>& Buffer, UPackageMap* PackageMap, EFunctionFlags VerifyFlags = FUNC_None);
 	static bool CallEventDelegate(UObject* Obj, const FName EventName, const TArray<uint8>& Buffer, UPackageMap* PackageMap);
-	static bool CallMessageFunction(UObject* Obj, UFunction* Function, const TArray<FGMPTypedAddr>& Params);
+	static bool CallMessageFunction(UObject* Obj, UFunction* Function, TArrayView<const FGMPTypedAddr> Params);
 
 public:
 	UFUNCTION(BlueprintPure, CustomThunk, meta = (Variadic, CallableWithoutWorldContext, BlueprintInternalUseOnly = true))
 	static void MessageFromVariadic(TArray<FGMPTypedAddr>& MsgArr);
 	DECLARE_FUNCTION(execMessageFromVariadic);
 
-	static bool MessageToFrame(UFunction* Function, void* FramePtr, const TArray<FGMPTypedAddr>& Params);
-	static bool MessageToArchive(FArchive& ArToSave, UFunction* Function, const TArray<FGMPTypedAddr>& Params, UPackageMap* PackageMap = nullptr);
+	static bool MessageToFrame(UFunction* Function, void* FramePtr, TArrayView<const FGMPTypedAddr> Params);
+	static bool MessageToArchive(FArchive& ArToSave, UFunction* Function, TArrayView<const FGMPTypedAddr> Params, UPackageMap* PackageMap = nullptr);
 	static bool ArchiveToFrame(FArchive& ArToLoad, UFunction* Function, void* FramePtr, UPackageMap* PackageMap = nullptr);
 	static bool ArchiveToMessage(const TArray<uint8>& Buffer, GMP::FTypedAddresses& Params, const TArray<FProperty*>& Props, UPackageMap* PackageMap = nullptr);
 	template<typename... TArgs>
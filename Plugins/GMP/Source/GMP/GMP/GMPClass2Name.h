@@ -89,6 +89,9 @@ struct GMP_API FNameSuccession
 	{
 		return *FString::Printf(ObjectPtrFormatStr(), *TUnwrapObjectPtrType<T>::StaticClass()->GetName());
 	}
+
+private:
+	static bool IsTypeCompatibleImpl(FName lhs, FName rhs);
 };
 
 namespace Class2Name
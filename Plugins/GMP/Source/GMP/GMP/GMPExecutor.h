@@ -0,0 +1,53 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+
+#include "HAL/PlatformAffinity.h"
+
+class FQueuedThreadPool;
+class UObject;
+
+namespace GMP
+{
+enum class EGMPExecType : uint8
+{
+	Inline,
+	TaskGraph,
+	ThreadPool,
+};
+
+// where a listener runs, inline listeners run on the game thread inside the fire
+// hub listeners off the game thread need a copy of the send arguments, sends that can not copy them (script sends,
+// non-copyable arguments) run those listeners inline, listens whose own arguments are not copyable are refused
+struct GMP_API FGMPExecTarget
+{
+	using FPinnedObjects = TArray<UObject*, TInlineAllocator<4>>;
+
+	static FGMPExecTarget Inline() { return FGMPExecTarget(); }
+	static FGMPExecTarget TaskGraph() { return FGMPExecTarget(EGMPExecType::TaskGraph); }
+	// the pool must be registered first, unknown names fall back to the task graph
+	static FGMPExecTarget ThreadPool(FName PoolName);
+
+	// creates and owns a pool, or wraps an external one which must outlive the registration
+	static bool RegisterPool(FName PoolName, int32 NumThreads, EThreadPriority Priority = TPri_BelowNormal);
+	static bool RegisterPool(FName PoolName, FQueuedThreadPool* ExternalPool);
+	// queued tasks of an owned pool are abandoned, their pins are still released
+	static void UnregisterPool(FName PoolName);
+
+	FORCEINLINE bool IsInline() const { return Type == EGMPExecType::Inline; }
+	FORCEINLINE EGMPExecType GetType() const { return Type; }
+	void Execute(TUniqueFunction<void()>&& Task) const;
+	// game thread only, PinnedObjs are kept from GC until the task has run or was abandoned
+	void Execute(TUniqueFunction<void()>&& Task, FPinnedObjects&& PinnedObjs) const;
+
+private:
+	explicit FGMPExecTarget(EGMPExecType InType = EGMPExecType::Inline, uint8 InPoolIndex = 0)
+		: Type(InType)
+		, PoolIndex(InPoolIndex)
+	{
+	}
+	EGMPExecType Type;
+	uint8 PoolIndex;
+};
+}  // namespace GMP
@@ -24,6 +24,23 @@ struct FStorageErase
 	void* HeapAllocation = nullptr;
 };
 
+// 16-byte size classes carved out of shared chunks, used for FSigElm and functors which do not fit inline
+struct GMP_API FGMPSlabPool
+{
+	enum : uint32
+	{
+		kClassGranularity = 16,
+		kMaxClassSize = 256,
+	};
+	static void* Malloc(uint32 Size, uint32 Alignment);
+	static void Free(void* Ptr, uint32 Size, uint32 Alignment);
+
+	// frees every chunk without live blocks, including the one spare each class keeps
+	static void ReleaseUnused();
+	static int32 GetLiveNum();
+	static void DumpStats(FOutputDevice& Ar);
+};
+
 template<typename TSig>
 struct TGMPFunctionRef;
 
@@ -79,6 +96,7 @@ struct IErasedObject
 	virtual void* GetObjectAddress() = 0;
 	virtual uint32 GetObjectSize() const = 0;
 	virtual void PlacementDtor() = 0;
+	virtual void HeapDtor() = 0;
 	virtual void* MoveConstruct(FStorageErase* Target, uint32 InlineSize) = 0;
 	virtual ~IErasedObject() = default;
 };
@@ -97,6 +115,11 @@ struct TTypedObject final : public IErasedObject
 	virtual void* GetObjectAddress() override { return &Obj; }
 	virtual uint32 GetObjectSize() const override { return sizeof(T); }
 	virtual void PlacementDtor() override { this->~TTypedObject(); }
+	virtual void HeapDtor() override
+	{
+		this->~TTypedObject();
+		FGMPSlabPool::Free(this, sizeof(TTypedObject), alignof(TTypedObject));
+	}
 	virtual void* MoveConstruct(FStorageErase* Target, uint32 InlineSize) override;
 
 	T Obj;
@@ -154,7 +177,7 @@ struct TStorageErase : protected FStorageErase
 		void* NewAlloc;
 		GMP_IF_CONSTEXPR(!bUseInline)
 		{
-			NewAlloc = FMemory::Malloc(sizeof(FunctorType), alignof(FunctorType));
+			NewAlloc = FGMPSlabPool::Malloc(sizeof(FunctorType), alignof(FunctorType));
 			GMP_DEBUGVIEW_LOG(TEXT("TStorageErase::ConstructObject()::Malloc %p"), NewAlloc);
 			HeapAllocation = NewAlloc;
 		}
@@ -174,12 +197,15 @@ struct TStorageErase : protected FStorageErase
 		{
 			IErasedObject* Owned = GetErasedWrapper();
 			GMP_DEBUGVIEW_LOG(TEXT("TStorageErase::DestroyObject() %p"), Owned);
-			Owned->PlacementDtor();
 			if (HeapAllocation)
 			{
-				FMemory::Free(HeapAllocation);
+				Owned->HeapDtor();
 				HeapAllocation = nullptr;
 			}
+			else
+			{
+				Owned->PlacementDtor();
+			}
 			Callable = nullptr;
 		}
 	}
@@ -233,7 +259,7 @@ void* TTypedObject<T>::MoveConstruct(FStorageErase* Target, uint32 InlineSize)
 	void* NewAlloc;
 	if (sizeof(TTypedObject) > InlineSize)
 	{
-		NewAlloc = FMemory::Malloc(sizeof(TTypedObject), alignof(TTypedObject));
+		NewAlloc = FGMPSlabPool::Malloc(sizeof(TTypedObject), alignof(TTypedObject));
 		GMP_DEBUGVIEW_LOG(TEXT("TTypedObject::MoveConstruct()::Malloc [%p] On Inc[%p]"), NewAlloc, this);
 		Storage->HeapAllocation = NewAlloc;
 	}
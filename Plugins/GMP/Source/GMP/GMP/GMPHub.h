@@ -4,6 +4,8 @@
 #include "CoreMinimal.h"
 
 #include "Delegates/Delegate.h"
+#include "GMPExecutor.h"
+#include "GMPMessageQueue.h"
 #include "GMPSignals.inl"
 #include "GMPSignalsInc.h"
 #include "GMPStruct.h"
@@ -16,6 +18,11 @@
 #define GMP_REDUCE_IGMPSIGNALS_CAST 1
 #endif
 
+// 1 lets the hub of UGMPManager keep the listeners of each game world apart, see FMessageHub::EnableWorldShards
+#ifndef GMP_WORLD_SHARDED_HUB
+#define GMP_WORLD_SHARDED_HUB 0
+#endif
+
 class UGMPBPLib;
 
 namespace GMP
@@ -74,18 +81,66 @@ GMP_MSG_OF(FSimpleDelegate)
 
 namespace GMP
 {
-using FGMPSignalMap = TMap<FName, FSignalBase>;
+// signals indexed by FMessageKeyIndex
+struct FGMPSignalMap
+{
+	FORCEINLINE FSignalBase* Find(int32 Index) { return (Signals.IsValidIndex(Index) && Signals[Index].Store.IsValid()) ? &Signals[Index] : nullptr; }
+	FORCEINLINE const FSignalBase* Find(int32 Index) const { return const_cast<FGMPSignalMap*>(this)->Find(Index); }
+	FSignalBase& FindOrAdd(int32 Index)
+	{
+		check(Index >= 0);
+		if (Index >= Signals.Num())
+			Signals.SetNum(Index + 1);
+		return Signals[Index];
+	}
+	// trailing empty entries are trimmed so the array follows the highest key still listened
+	void Remove(int32 Index)
+	{
+		if (!Signals.IsValidIndex(Index))
+			return;
+		Signals[Index].Store.Reset();
+		int32 Num = Signals.Num();
+		while (Num > 0 && !Signals[Num - 1].Store.IsValid())
+			--Num;
+		Signals.SetNum(Num);
+	}
+
+private:
+	TArray<FSignalBase> Signals;
+};
+
 template<typename T = FSignalBase>
 FORCEINLINE auto FindSig(FGMPSignalMap& Map, FName Name)
 {
-	return static_cast<T*>(Map.Find(Name));
+	return static_cast<T*>(Map.Find(FMessageKeyIndex::Find(Name)));
 }
 template<typename T = FSignalBase>
 FORCEINLINE auto FindSig(const FGMPSignalMap& Map, FName Name)
 {
-	return static_cast<const T*>(Map.Find(Name));
+	return static_cast<const T*>(Map.Find(FMessageKeyIndex::Find(Name)));
+}
+template<typename T = FSignalBase, EFindName EType>
+FORCEINLINE auto FindSig(FGMPSignalMap& Map, const TMSGKEYBase<EType>& Key)
+{
+	return static_cast<T*>(Map.Find(Key.ResolveMessageIndex()));
+}
+template<typename T = FSignalBase, EFindName EType>
+FORCEINLINE auto FindSig(const FGMPSignalMap& Map, const TMSGKEYBase<EType>& Key)
+{
+	return static_cast<const T*>(Map.Find(Key.ResolveMessageIndex()));
 }
 
+// how deferred sends of one message key and source within a frame are folded
+enum class ECoalescePolicy : uint8
+{
+	// only the arguments of the last send
+	KeepLast,
+	// arithmetic arguments and non-container ones with operator+= are summed, the rest keep the last value
+	Accumulate,
+	// every send in order, listeners still run at the flush
+	KeepAll,
+};
+
 namespace Hub
 {
 	template<typename F, typename... TArgs, size_t... Is>
@@ -118,12 +173,75 @@ namespace Hub
 		return FTypedAddresses{FGMPTypedAddr::MakeMsg(std::get<Is>(InTup))...};
 	}
 
+	template<typename... TArgs>
+	struct TMessagePayload final : public FMessagePayload
+	{
+		template<typename Tup, size_t... Is>
+		TMessagePayload(const Tup& InTup, std::index_sequence<Is...>*)
+			: Args(std::get<Is>(InTup)...)
+		{
+			Params = MakeParamFromTuple(Args, std::index_sequence_for<TArgs...>());
+			int Dummy[] = {0, (AddWeakObject(std::get<Is>(Args), 0), 0)...};
+			(void)Dummy;
+		}
+
+		virtual TSharedRef<FMessagePayload, ESPMode::ThreadSafe> Clone() const override
+		{
+			auto Copy = MakeShared<TMessagePayload, ESPMode::ThreadSafe>(Args, (std::index_sequence_for<TArgs...>*)nullptr);
+			Copy->MessageId = MessageId;
+			Copy->SigSrc = SigSrc;
+			Copy->SequenceId = SequenceId;
+			Copy->PayloadSize = PayloadSize;
+			return Copy;
+		}
+
+	protected:
+		template<typename T>
+		std::enable_if_t<std::is_base_of<UObject, T>::value> AddWeakObject(T* Obj, int)
+		{
+			if (Obj)
+				WeakObjects.Add(FWeakObjectPtr(Obj));
+		}
+		template<typename T>
+		void AddWeakObject(const T&, ...)
+		{
+		}
+
+		std::tuple<TArgs...> Args;
+	};
+
+	template<typename Tup>
+	struct TPayloadMaker;
+	template<typename... Ts>
+	struct TPayloadMaker<std::tuple<Ts...>>
+	{
+		static TSharedPtr<FMessagePayload, ESPMode::ThreadSafe> Make(const void* InTup)
+		{
+			using FPayload = TMessagePayload<std::decay_t<Ts>...>;
+			auto Payload = MakeShared<FPayload, ESPMode::ThreadSafe>(*static_cast<const std::tuple<Ts...>*>(InTup), (std::index_sequence_for<Ts...>*)nullptr);
+			Payload->PayloadSize = sizeof(FPayload);
+			return Payload;
+		}
+		static FMessageBody::FPayloadMaker Get(const std::tuple<Ts...>& InTup, std::true_type) { return {&InTup, &Make}; }
+		static FMessageBody::FPayloadMaker Get(const std::tuple<Ts...>& InTup, std::false_type) { return {}; }
+		static FMessageBody::FPayloadMaker Get(const std::tuple<Ts...>& InTup)
+		{
+			return Get(InTup, std::integral_constant<bool, TAnd<std::is_copy_constructible<std::decay_t<Ts>>...>::Value>());
+		}
+	};
+
 	template<typename Tup, size_t... Is>
 	static decltype(auto) MakeNamesImpl(Tup* InTup, const std::index_sequence<Is...>&)
 	{
 		return FMessageBody::MakeStaticNamesImpl<std::decay_t<std::tuple_element_t<Is, Tup>>...>();
 	}
 
+	template<typename Tup, size_t... Is>
+	static uint64 MakeSignatureHashImpl(Tup* InTup, const std::index_sequence<Is...>&)
+	{
+		return FMessageBody::MakeStaticSignatureHash<std::decay_t<std::tuple_element_t<Is, Tup>>...>();
+	}
+
 	template<typename FuncType>
 	struct TMessageTraits
 	{
@@ -152,6 +270,19 @@ namespace Hub
 		}
 	};
 
+	template<typename Tup>
+	struct THasMutableRef;
+	template<typename... Ts>
+	struct THasMutableRef<std::tuple<Ts...>> : std::integral_constant<bool, TOr<std::integral_constant<bool, std::is_lvalue_reference<Ts>::value && !std::is_const<std::remove_reference_t<Ts>>::value>...>::Value>
+	{
+	};
+	template<typename Tup>
+	struct TIsCopyableTuple;
+	template<typename... Ts>
+	struct TIsCopyableTuple<std::tuple<Ts...>> : std::integral_constant<bool, TAnd<std::is_copy_constructible<std::decay_t<Ts>>...>::Value>
+	{
+	};
+
 	template<typename FuncType, typename = void>
 	struct TListenArgumentsTraits
 	{
@@ -160,7 +291,9 @@ namespace Hub
 		enum
 		{
 			bIsSingleShot = TypeTraits::IsSameV<FGMPResponder&, std::remove_cv_t<typename MyTraits::LastType>>,
-			TupleSize = std::tuple_size<Tuple>::value
+			TupleSize = std::tuple_size<Tuple>::value,
+			bHasMutableRef = THasMutableRef<Tuple>::value,
+			bIsCopyable = TIsCopyableTuple<Tuple>::value,
 		};
 
 		template<typename T, typename F>
@@ -183,6 +316,7 @@ namespace Hub
 			return MyTraits::MakeCallback(InMsgHub, std::move(Func), std::conditional_t<bIsSingleShot, std::true_type, std::false_type>());
 		}
 		static decltype(auto) MakeNames() { return MakeNamesImpl((Tuple*)nullptr, std::make_index_sequence<TupleSize - (bIsSingleShot ? 1 : 0)>()); }
+		static uint64 MakeSignatureHash() { return MakeSignatureHashImpl((Tuple*)nullptr, std::make_index_sequence<TupleSize - (bIsSingleShot ? 1 : 0)>()); }
 	};
 
 	struct DefaultTraits
@@ -203,8 +337,154 @@ namespace Hub
 			return MakeNamesImpl((Tup*)nullptr, std::make_index_sequence<std::tuple_size<Tup>::value>());
 		}
 
+		template<typename Tup>
+		static uint64 MakeSignatureHash(Tup& InTup)
+		{
+			return MakeSignatureHashImpl((Tup*)nullptr, std::make_index_sequence<std::tuple_size<Tup>::value>());
+		}
+
 		FORCEINLINE static auto MakeSingleShot(const FName&, const void*) { return nullptr; }
+
+		template<typename Tup>
+		FORCEINLINE static FMessageBody::FPayloadMaker MakePayloadMaker(const Tup& InTup)
+		{
+			return TPayloadMaker<Tup>::Get(InTup);
+		}
 	};
+
+	// object pointer arguments of copies sent later, which must not be sent once any of them is collected
+	using FWeakObjectArgs = TArray<FWeakObjectPtr, TInlineAllocator<2>>;
+	template<typename T>
+	std::enable_if_t<std::is_base_of<UObject, T>::value> AddWeakObjectArg(FWeakObjectArgs& Out, T* Obj, int)
+	{
+		if (Obj)
+			Out.Add(FWeakObjectPtr(Obj));
+	}
+	template<typename T>
+	void AddWeakObjectArg(FWeakObjectArgs&, const T&, ...)
+	{
+	}
+	template<typename... TArgs, size_t... Is>
+	void AddWeakObjectArgs(FWeakObjectArgs& Out, const std::tuple<TArgs...>& InArgs, std::index_sequence<Is...>)
+	{
+		int Dummy[] = {0, (AddWeakObjectArg(Out, std::get<Is>(InArgs), 0), 0)...};
+		(void)Dummy;
+	}
+	FORCEINLINE bool HasStaleObjectArgs(const FWeakObjectArgs& WeakArgs)
+	{
+		return WeakArgs.ContainsByPredicate([](const FWeakObjectPtr& Weak) { return !Weak.IsValid(); });
+	}
+
+	// arguments copied by value into FPostedMessageQueue
+	template<typename... TArgs>
+	struct TPostedMessage
+	{
+		template<typename... Ts>
+		TPostedMessage(uint32 InHubSerial, const FMSGKEY& InKey, FSigSource InSigSrc, Ts&&... InArgs)
+			: HubSerial(InHubSerial)
+			, MessageKey(InKey)
+			, SigSrc(InSigSrc)
+			, WeakSrc(InSigSrc.TryGetUObject())
+			, Args(std::forward<Ts>(InArgs)...)
+		{
+			AddWeakObjectArgs(WeakArgs, Args, std::index_sequence_for<TArgs...>());
+		}
+		void Dispatch();
+
+	protected:
+		template<size_t... Is>
+		void DispatchImpl(FMessageHub* Hub, std::index_sequence<Is...>*);
+
+		// the hub is found again by serial, it may have been destroyed before the queue drained
+		uint32 HubSerial;
+		FMSGKEY MessageKey;
+		FSigSource SigSrc;
+		FWeakObjectPtr WeakSrc;
+		FWeakObjectArgs WeakArgs;
+		std::tuple<TArgs...> Args;
+	};
+
+	// sends of one message key and source queued by FMessageHub::DeferObjectMessage until the next flush
+	struct FCoalescedMessage
+	{
+		FCoalescedMessage(const FMSGKEY& InKey, FSigSource InSigSrc, ECoalescePolicy InPolicy)
+			: MessageKey(InKey)
+			, SigSrc(InSigSrc)
+			, WeakSrc(InSigSrc.TryGetUObject())
+			, Policy(InPolicy)
+		{
+		}
+		virtual ~FCoalescedMessage() = default;
+		virtual const void* GetTypeTag() const = 0;
+		virtual void Dispatch(FMessageHub* Hub) = 0;
+
+		FMSGKEY MessageKey;
+		FSigSource SigSrc;
+		FWeakObjectPtr WeakSrc;
+		ECoalescePolicy Policy;
+		int32 SendNum = 0;
+	};
+
+	template<typename T>
+	FORCEINLINE auto AccumulateArg(T& Acc, const T& Val, int) -> decltype(Acc += Val, std::enable_if_t<std::is_arithmetic<T>::value || !TIsContiguousContainer<T>::Value>())
+	{
+		Acc += Val;
+	}
+	template<typename T>
+	FORCEINLINE void AccumulateArg(T& Acc, const T& Val, ...)
+	{
+		Acc = Val;
+	}
+
+	template<typename... TArgs>
+	struct TCoalescedMessage final : public FCoalescedMessage
+	{
+		using FCoalescedMessage::FCoalescedMessage;
+		static const void* StaticTypeTag()
+		{
+			static const char Tag = 0;
+			return &Tag;
+		}
+		virtual const void* GetTypeTag() const override { return StaticTypeTag(); }
+		virtual void Dispatch(FMessageHub* Hub) override;
+
+		template<typename... Ts>
+		void Add(Ts&&... InArgs)
+		{
+			++SendNum;
+			if (Policy == ECoalescePolicy::KeepAll || !Args.Num())
+			{
+				Args.Emplace(std::forward<Ts>(InArgs)...);
+				WeakArgs.AddDefaulted();
+			}
+			else if (Policy == ECoalescePolicy::KeepLast)
+			{
+				Args[0] = std::tuple<TArgs...>(std::forward<Ts>(InArgs)...);
+				WeakArgs[0].Reset();
+			}
+			else
+			{
+				AccumulateImpl(Args[0], std::tuple<TArgs...>(std::forward<Ts>(InArgs)...), std::index_sequence_for<TArgs...>());
+				WeakArgs[0].Reset();
+			}
+			AddWeakObjectArgs(WeakArgs.Last(), Args.Last(), std::index_sequence_for<TArgs...>());
+		}
+
+	protected:
+		template<size_t... Is>
+		static void AccumulateImpl(std::tuple<TArgs...>& Acc, const std::tuple<TArgs...>& Val, std::index_sequence<Is...>)
+		{
+			int Dummy[] = {0, (AccumulateArg(std::get<Is>(Acc), std::get<Is>(Val), 0), 0)...};
+			(void)Dummy;
+		}
+		template<size_t... Is>
+		void DispatchImpl(FMessageHub* Hub, std::tuple<TArgs...>& InArgs, std::index_sequence<Is...>*);
+
+		TArray<std::tuple<TArgs...>, TInlineAllocator<1>> Args;
+		// the object arguments of each entry of Args, which is not sent once any of them is collected
+		TArray<FWeakObjectArgs, TInlineAllocator<1>> WeakArgs;
+	};
+
 	struct DefaultLessTraits
 	{
 		enum
@@ -227,6 +507,13 @@ namespace Hub
 			return MakeNamesImpl((Tup*)nullptr, std::make_index_sequence<TupleSize - 1>());
 		}
 
+		template<typename Tup>
+		static uint64 MakeSignatureHash(Tup& InTup)
+		{
+			const auto TupleSize = std::tuple_size<Tup>::value;
+			return MakeSignatureHashImpl((Tup*)nullptr, std::make_index_sequence<TupleSize - 1>());
+		}
+
 		template<typename F>
 		static FResponeSig MakeSingleShotImpl(const FName& SingleShotId, F&& OnRsp);
 
@@ -237,6 +524,13 @@ namespace Hub
 			using LastType = std::tuple_element_t<TupleSize - 1, Tup>;
 			return MakeSingleShotImpl(SingleShotId, std::forward<LastType>(std::get<TupleSize - 1>(*InTup)));
 		}
+
+		// requests are answered on the game thread and never shared off it
+		template<typename Tup>
+		FORCEINLINE static FMessageBody::FPayloadMaker MakePayloadMaker(const Tup&)
+		{
+			return {};
+		}
 	};
 
 	template<typename LastType, typename Enable = void>
@@ -334,15 +628,18 @@ private:
 	}
 
 	// Listen
-	FGMPKey ListenMessageImpl(const FName& MessageKey, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Func, int32 Times = -1);
-	FGMPKey ListenMessageImpl(const FName& MessageKey, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Func, int32 Times = -1);
+	FGMPKey ListenMessageImpl(const FMSGKEY& MessageKey, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Func, int32 Times = -1);
+	FGMPKey ListenMessageImpl(const FMSGKEY& MessageKey, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Func, int32 Times = -1);
 
 	// Unlisten
-	void UnListenMessageImpl(const FName& MessageKey, FGMPKey InKey);
-	void UnListenMessageImpl(const FName& MessageKey, const UObject* Listener = nullptr);
-	void UnListenMessageImpl(const FName& MessageKey, const UObject* Listener, FSigSource InSigSrc);
+	void UnListenMessageImpl(const FMSGKEYFind& MessageKey, FGMPKey InKey);
+	void UnListenMessageImpl(const FMSGKEYFind& MessageKey, const UObject* Listener = nullptr);
+	void UnListenMessageImpl(const FMSGKEYFind& MessageKey, const UObject* Listener, FSigSource InSigSrc);
+	FGMPKey ListenPrefixImpl(const FName& Prefix, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Func, int32 Times);
+	FGMPKey ListenPrefixImpl(const FName& Prefix, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Func, int32 Times);
+
 	// Notify
-	FGMPKey NotifyMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param);
+	FGMPKey NotifyMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, FMessageBody::FPayloadMaker PayloadMaker = {});
 
 	// Request
 	FGMPKey RequestMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, FResponeSig&& Sig, const FArrayTypeNames* RspTypes = nullptr);
@@ -352,8 +649,14 @@ private:
 private:
 	//////////////////////////////////////////////////////////////////////////
 	// Send
-	FORCEINLINE FGMPKey SendObjectMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, std::nullptr_t) { return NotifyMessageImpl(Ptr, MessageKey, InSigSrc, Param); }
-	FORCEINLINE FGMPKey SendObjectMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, FResponeSig&& OnRsp) { return RequestMessageImpl(Ptr, MessageKey, InSigSrc, Param, std::move(OnRsp)); }
+	FORCEINLINE FGMPKey SendObjectMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, std::nullptr_t, FMessageBody::FPayloadMaker PayloadMaker) { return NotifyMessageImpl(Ptr, MessageKey, InSigSrc, Param, PayloadMaker); }
+	FORCEINLINE FGMPKey SendObjectMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, FResponeSig&& OnRsp, FMessageBody::FPayloadMaker = {}) { return RequestMessageImpl(Ptr, MessageKey, InSigSrc, Param, std::move(OnRsp)); }
+
+	// wraps a listener so it runs on ExecTarget with the shared payload of each send, or a copy of it with bMutableArgs
+	// the listener and the object arguments are kept alive from the fire until the task returns
+	static FGMPMessageSig MakeAsyncCallback(FGMPExecTarget ExecTarget, FGMPMessageSig&& Func, const UObject* Listener, bool bMutableArgs);
+	static FORCEINLINE const UObject* ToAsyncListener(const UObject* InObj) { return InObj; }
+	static FORCEINLINE const UObject* ToAsyncListener(const FSigCollection*) { return nullptr; }
 
 public:
 #if GMP_WITH_DYNAMIC_CALL_CHECK && WITH_EDITOR
@@ -380,7 +683,7 @@ public:
 #if GMP_WITH_DYNAMIC_CALL_CHECK
 		const auto& ArgNames = SendTraits::MakeNames(TupRef);
 		const FArrayTypeNames* OldParams = nullptr;
-		if (!IsSignatureCompatible(true, MessageKey, ArgNames, OldParams))
+		if (!IsSignatureCompatible(true, MessageKey, ArgNames, OldParams, true, SendTraits::MakeSignatureHash(TupRef)))
 		{
 			ensureAlwaysMsgf(false, TEXT("SignatureMismatch On Send %s"), *MessageKey.ToString());
 			return 0;
@@ -389,29 +692,63 @@ public:
 
 		TraceMessageKey(MessageKey, InSigSrc);
 
-		if (auto Ptr = FindSig(MessageSignals, MessageKey))
+		auto Ptr = FindSig(MessageSignals, MessageKey);
+		if (Ptr || HasWorldListeners(MessageKey, InSigSrc) || HasPrefixListeners(MessageKey) || IsRetainedKey(MessageKey))
 		{
 			auto Arr = SendTraits::MakeParam(TupRef);
-			return SendObjectMessageImpl(Ptr, MessageKey, InSigSrc, Arr, SendTraits::MakeSingleShot(MessageKey, &TupRef));
+			return SendObjectMessageImpl(Ptr, MessageKey, InSigSrc, Arr, SendTraits::MakeSingleShot(MessageKey, &TupRef), SendTraits::MakePayloadMaker(TupRef));
 		}
 		return 0;
 	}
 
+	// can be called from any thread, arguments are copied and sent when the posted queue is drained on the game thread
+	template<typename... TArgs>
+	bool PostObjectMessage(const FMSGKEY& MessageKey, FSigSource InSigSrc, TArgs&&... Args)
+	{
+		using FPostedMessage = Hub::TPostedMessage<std::decay_t<TArgs>...>;
+		return FPostedMessageQueue::Get().Enqueue<FPostedMessage>(HubSerial, MessageKey, InSigSrc, std::forward<TArgs>(Args)...);
+	}
+
+	// sends posted messages now instead of waiting for GMP.PostedMessageFlushPoint
+	static int32 FlushPostedMessages() { return FPostedMessageQueue::Get().Drain(); }
+
+	// game thread only, sends of the same key and source are folded by Policy and sent once per frame at GMP.CoalescedTickGroup
+	// the policy and argument types of the first send of a frame win, a mismatching one sends the queued message first
+	template<typename... TArgs>
+	void DeferObjectMessage(const FMSGKEY& MessageKey, FSigSource InSigSrc, ECoalescePolicy Policy, TArgs&&... Args)
+	{
+		checkSlow(IsInGameThread());
+		using FCoalesced = Hub::TCoalescedMessage<std::decay_t<TArgs>...>;
+		auto Message = FindCoalesced(MessageKey, InSigSrc);
+		if (Message && !ensureMsgf(Message->GetTypeTag() == FCoalesced::StaticTypeTag() && Message->Policy == Policy, TEXT("deferred message %s changed its arguments or policy within a frame"), *MessageKey.ToString()))
+		{
+			SendCoalesced(Message);
+			Message = nullptr;
+		}
+		if (!Message)
+			Message = AddCoalesced(MakeUnique<FCoalesced>(MessageKey, InSigSrc, Policy));
+		static_cast<FCoalesced*>(Message)->Add(std::forward<TArgs>(Args)...);
+	}
+
+	// sends deferred messages of every hub now, returns the number of folded messages sent
+	static int32 FlushDeferredMessages();
+
 	template<typename T, typename F>
-	FORCEINLINE FGMPKey ListenMessage(const FMSGKEY& MessageId, T* Listener, F&& Func, int32 Times = -1)
+	FORCEINLINE FGMPKey ListenMessage(const FMSGKEY& MessageId, T* Listener, F&& Func, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
-		return ListenObjectMessage(MessageId, nullptr, Listener, std::forward<F>(Func), Times);
+		return ListenObjectMessage(MessageId, nullptr, Listener, std::forward<F>(Func), Times, ExecTarget);
 	}
 
+	// listeners off the game thread get copies of the arguments, shared unless taken by mutable reference, and must not touch UObjects
 	template<typename T, typename F>
-	FGMPKey ListenObjectMessage(const FMSGKEY& MessageId, FSigSource InSigSrc, T* Listener, F&& Func, int32 Times = -1)
+	FGMPKey ListenObjectMessage(const FMSGKEY& MessageId, FSigSource InSigSrc, T* Listener, F&& Func, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
-		auto&& MessageKey = ToMessageKey(MessageId);
+		const FMSGKEY& MessageKey = MessageId;
 		using ListenTraits = Hub::TListenArgumentsTraits<F>;
 #if GMP_WITH_DYNAMIC_CALL_CHECK
 		const auto& ArgNames = ListenTraits::MakeNames();
 		const FArrayTypeNames* OldParams = nullptr;
-		if (!IsSignatureCompatible(false, MessageKey, ArgNames, OldParams))
+		if (!IsSignatureCompatible(false, MessageKey, ArgNames, OldParams, true, ListenTraits::MakeSignatureHash()))
 		{
 			ensureAlwaysMsgf(false, TEXT("SignatureMismatch On Listen %s"), *MessageKey.ToString());
 			return 0;
@@ -422,11 +759,22 @@ public:
 		{
 			ensureAlways(GIsEditor || !CallbackMarks.Contains(MessageKey));
 			CallbackMarks.Add(MessageKey);
+			ensureMsgf(ExecTarget.IsInline(), TEXT("responders of %s run inline"), *MessageKey.ToString());
+			ExecTarget = FGMPExecTarget::Inline();
 		}
 
-		return ListenMessageImpl(MessageKey, InSigSrc, ToSigListenner(Listener), ListenTraits::MakeCallback(this, Listener, std::forward<F>(Func)), Times);
+		if (!ExecTarget.IsInline() && !ensureMsgf(ListenTraits::bIsCopyable, TEXT("listeners of %s off the game thread need copyable arguments"), *MessageKey.ToString()))
+			return 0;
+
+		FGMPMessageSig Callback = ListenTraits::MakeCallback(this, Listener, std::forward<F>(Func));
+		if (!ExecTarget.IsInline())
+			Callback = MakeAsyncCallback(ExecTarget, MoveTemp(Callback), ToAsyncListener(Listener), ListenTraits::bHasMutableRef);
+		return ListenMessageImpl(MessageKey, InSigSrc, ToSigListenner(Listener), MoveTemp(Callback), Times);
 	}
 
+	// listeners of higher priority run first, those of equal priority in listen order, FMessageBody::Consume stops the rest
+	void SetListenPriority(const FMSGKEYFind& MessageKey, FGMPKey InKey, int32 Priority);
+
 	FORCEINLINE void UnListenMessage(const FMSGKEYFind& MessageKey, FGMPKey InKey)
 	{
 		if (MessageKey)
@@ -445,12 +793,35 @@ public:
 			UnListenMessageImpl(MessageKey, Listener, InSigSrc);
 	}
 
+	// prefix listeners receive every notification whose key is Prefix or starts with "Prefix.", requests stay exact
+	template<typename T>
+	FORCEINLINE FGMPKey ListenMessagePrefix(const FName& Prefix, T* Listener, FGMPMessageSig&& Func, FSigSource InSigSrc = FSigSource::NullSigSrc, int32 Times = -1)
+	{
+		return ListenPrefixImpl(Prefix, InSigSrc, ToSigListenner(Listener), MoveTemp(Func), Times);
+	}
+	void UnListenMessagePrefix(const FName& Prefix, FGMPKey InKey);
+	void UnListenMessagePrefix(const FName& Prefix, const UObject* Listener);
+
+	// a retained key keeps the payload of its last notification and replays it to each listener connecting later
+	// bPerSource keeps the last payload of every sig source instead of one for the key
+	// sends that can not copy their arguments, script sends among them, are not retained and drop the payload retained before them
+	// object arguments are held weakly and drop the payload once collected
+	void SetMessageRetained(const FName& MessageKey, bool bRetain = true, bool bPerSource = false);
+	void ClearRetained(const FName& MessageKey);
+	void ClearRetained();
+	void DumpRetained(FOutputDevice& Ar) const;
+
 	bool IsAlive(const FName& MessageId, FGMPKey Key = 0) const;
 	FGMPKey IsAlive(const FName& MessageId, const UObject* Listener, FSigSource InSigSrc = FSigSource::NullSigSrc) const;
 	bool IsValidHub() const;
+	// unique per hub instance for the whole process
+	FORCEINLINE uint32 GetHubSerial() const { return HubSerial; }
+	// game thread only, null once that hub is destroyed
+	static FMessageHub* FindHub(uint32 InHubSerial);
 	bool IsResponseOn(FGMPKey Key) const;
 
-	static bool IsSignatureCompatible(bool bCall, const FName& MessageId, const FArrayTypeNames& TypeNames, const FArrayTypeNames*& OldTypes, bool bNativeCall = true);
+	// SignatureHash is computed from TypeNames when zero, hashes already verified for MessageId skip the name comparison
+	static bool IsSignatureCompatible(bool bCall, const FName& MessageId, const FArrayTypeNames& TypeNames, const FArrayTypeNames*& OldTypes, bool bNativeCall = true, uint64 SignatureHash = 0);
 	static bool IsSingleshotCompatible(bool bCall, const FName& MessageId, const FArrayTypeNames& TypeNames, const FArrayTypeNames*& OldTypes, bool bNativeCall = true);
 
 public:
@@ -465,7 +836,7 @@ public:
 #if GMP_WITH_DYNAMIC_CALL_CHECK
 		const auto& ArgNames = FMessageBody::MakeStaticNamesImpl<std::decay_t<TArgs>...>();
 		const FArrayTypeNames* OldParams = nullptr;
-		if (!IsSignatureCompatible(true, MessageKey, ArgNames, OldParams))
+		if (!IsSignatureCompatible(true, MessageKey, ArgNames, OldParams, true, FMessageBody::MakeStaticSignatureHash<std::decay_t<TArgs>...>()))
 		{
 			ensureAlwaysMsgf(false, TEXT("SignatureMismatch On Request %s"), *MessageKey.ToString());
 			return 0;
@@ -555,7 +926,7 @@ public:  // for script binding
 		TraceMessageKey(MessageKey, InSigSrc);
 
 		auto Ptr = FindSig(MessageSignals, MessageKey);
-		return Ptr ? !!NotifyMessageImpl(Ptr, MessageKey, InSigSrc, Param) : true;
+		return (Ptr || HasWorldListeners(MessageKey, InSigSrc) || HasPrefixListeners(MessageKey) || IsRetainedKey(MessageKey)) ? !!NotifyMessageImpl(Ptr, MessageKey, InSigSrc, Param) : true;
 	}
 
 #if 1
@@ -583,8 +954,139 @@ public:
 	~FMessageHub();
 	FMessageHub();
 
+	// listeners, prefix listeners, retained payloads, deferred messages and pending responses of a game world are kept
+	// apart and freed in one go after the world is cleaned up, only with GMP_WORLD_SHARDED_HUB
+	// a listener in a world then no longer hears sources of other game worlds, and unlistening looks at every world
+	void EnableWorldShards();
+
 private:
 	FGMPSignalMap MessageSignals;
+	uint32 HubSerial = 0;
+	void ReleaseIfEmpty(const FMSGKEYFind& MessageKey, FSignalBase* Ptr);
+
+	// prefix listeners by the key index of the prefix, each message key caches the prefixes it fans out to on first send
+	struct FPrefixFanout
+	{
+		TArray<int32, TInlineAllocator<2>> Prefixes;
+		bool bBuilt = false;
+	};
+	struct FPrefixListeners
+	{
+		FGMPSignalMap Signals;
+		TArray<FPrefixFanout> Fanouts;
+		// prefixes whose listeners all ended are dropped lazily when a key under them is looked up
+		TArray<int32> ActivePrefixes;
+
+		const FPrefixFanout* FindFanout(int32 MessageIndex);
+		bool IsAlive(int32 MessageIndex) const;
+		void AddActive(int32 PrefixIndex);
+		void RemoveActive(int32 PrefixIndex);
+		FORCEINLINE bool HasListeners(int32 MessageIndex)
+		{
+			if (ActivePrefixes.Num() == 0)
+				return false;
+			// keys without active prefixes above them keep an empty built fan-out until a prefix over them is listened
+			if (Fanouts.IsValidIndex(MessageIndex) && Fanouts[MessageIndex].bBuilt && Fanouts[MessageIndex].Prefixes.Num() == 0)
+				return false;
+			return !!FindFanout(MessageIndex);
+		}
+		void Fire(int32 MessageIndex, FSigSource InSigSrc, FMessageBody& Msg);
+	};
+	FPrefixListeners PrefixListeners;
+
+	// keys without exact listeners may never have been interned, they still fan out to their prefixes
+	static FORCEINLINE int32 ToPrefixedIndex(FName MessageKey)
+	{
+		const int32 Index = FMessageKeyIndex::Find(MessageKey);
+		return Index != INDEX_NONE ? Index : FMessageKeyIndex::Intern(MessageKey);
+	}
+	template<EFindName EType>
+	static FORCEINLINE int32 ToPrefixedIndex(const TMSGKEYBase<EType>& MessageKey)
+	{
+		const int32 Index = MessageKey.ResolveMessageIndex();
+		return Index != INDEX_NONE ? Index : FMessageKeyIndex::Intern(MessageKey);
+	}
+	template<typename K>
+	FORCEINLINE bool HasPrefixListeners(const K& MessageKey)
+	{
+		if (PrefixListeners.ActivePrefixes.Num() == 0 && !(HasWorldShards() && HasWorldPrefixes()))
+			return false;
+		const int32 MessageIndex = ToPrefixedIndex(MessageKey);
+		return PrefixListeners.HasListeners(MessageIndex) || (HasWorldShards() && HasWorldPrefixListeners(MessageIndex));
+	}
+	bool HasWorldPrefixes() const;
+	bool HasWorldPrefixListeners(int32 MessageIndex);
+
+	// last payloads of retained keys, evicted oldest first beyond GMP.RetainedMaxEntries or GMP.RetainedMaxKB
+	struct FRetainedValue
+	{
+		FMessagePayloadPtr Payload;
+		FWeakObjectPtr WeakSrc;
+		uint64 Serial = 0;
+		uint32 Size = 0;
+	};
+	// payloads indexed by key then source, the eviction queue is in serial order and skips replaced payloads lazily
+	struct FRetainedStore
+	{
+		struct FOrder
+		{
+			FName MessageKey;
+			FSigSource SigSrc;
+			uint64 Serial;
+		};
+		TMap<FName, TMap<FSigSource, FRetainedValue>> Values;
+		TArray<FOrder> Order;
+		int32 OrderHead = 0;
+		int32 Num = 0;
+		int64 Bytes = 0;
+
+		const FRetainedValue* Find(const FName& MessageKey, FSigSource SigSrc) const;
+		FRetainedValue& Add(const FName& MessageKey, FSigSource SigSrc, FMessagePayloadPtr Payload);
+		void Remove(const FName& MessageKey, FSigSource SigSrc);
+		void Remove(const FName& MessageKey);
+		void Evict(int32 MaxNum, int64 MaxBytes);
+		void Empty();
+		void Dump(FOutputDevice& Ar) const;
+	};
+	TMap<FName, bool> RetainedKeys;
+	FRetainedStore RetainedValues;
+
+	FORCEINLINE bool IsRetainedKey(const FName& MessageKey) const { return RetainedKeys.Num() > 0 && RetainedKeys.Contains(MessageKey); }
+	void RetainPayload(FMessageBody& Msg);
+	struct FWorldShard;
+	void ReplayRetained(FSignalBase* Ptr, FWorldShard* Shard, const FName& MessageKey, FSigSource InSigSrc, const UObject* Listener, FGMPKey Key);
+
+	// deferred messages in first send order, slots are indexed by message key index and source
+	struct FCoalescedQueue
+	{
+		TArray<TUniquePtr<Hub::FCoalescedMessage>> Messages;
+		TMap<TPair<int32, FSigSource>, Hub::FCoalescedMessage*> Slots;
+	};
+	FCoalescedQueue CoalescedQueue;
+	FCoalescedQueue& GetCoalescedQueue(FSigSource InSigSrc);
+	Hub::FCoalescedMessage* FindCoalesced(const FMSGKEY& MessageKey, FSigSource InSigSrc);
+	Hub::FCoalescedMessage* AddCoalesced(TUniquePtr<Hub::FCoalescedMessage> Message);
+	void SendCoalesced(Hub::FCoalescedMessage* Message);
+	int32 FlushCoalesced();
+	int32 FlushCoalesced(FCoalescedQueue& Queue);
+
+	CallbackMapType& GetResponses(FSigSource InSigSrc);
+
+	// sends from a source in a game world fire that world's signals merged with the shared ones by priority, sends without a world reach every world
+	TArray<TUniquePtr<FWorldShard>> WorldShards;
+	bool bWorldShards = false;
+	FORCEINLINE bool HasWorldShards() const { return WorldShards.Num() > 0; }
+	// the shard of the world of the source, else of the listener, created on first use
+	FWorldShard* FindOrAddShard(FSigSource InSigSrc, const UObject* Listener = nullptr);
+	FGMPSignalMap& GetListenSignals(const FMSGKEY& MessageKey, FSigSource InSigSrc, const UObject* Listener, FWorldShard*& OutShard);
+	// whether the shard of the source world, or any shard for a source without a world, has signals for the key
+	FORCEINLINE bool HasWorldListeners(const FMSGKEYFind& MessageKey, FSigSource InSigSrc) const { return HasWorldShards() && FindWorldListeners(MessageKey, InSigSrc); }
+	bool FindWorldListeners(const FMSGKEYFind& MessageKey, FSigSource InSigSrc) const;
+	template<typename F>
+	void ForEachWorldShard(const UObject* WorldContextObj, const F& Func) const;
+	template<typename K, typename F>
+	void ForEachWorldSignal(const K& MessageKey, const UObject* WorldContextObj, const F& Func) const;
+	void FireSignal(TArrayView<const FSignalImpl* const> Signals, const FName& MessageKey, FSigSource InSigSrc, FMessageBody& Msg);
 
 	TSet<FName> CallbackMarks;
 
@@ -624,6 +1126,45 @@ namespace Hub
 
 		return FResponeSig([OnRsp{std::forward<F>(OnRsp)}](FMessageBody& Body) { Hub::Invoke<typename SingleshotTraits::Tuple>(OnRsp, Body); }, SingleShotId, FMessageBody::GetNextSequenceID());
 	}
+
+	template<typename... TArgs>
+	void TPostedMessage<TArgs...>::Dispatch()
+	{
+		// the source or an object argument was destroyed before the queue drained
+		if ((SigSrc.TryGetUObject() && !WeakSrc.IsValid()) || HasStaleObjectArgs(WeakArgs))
+			return;
+
+		if (FMessageHub* Hub = FMessageHub::FindHub(HubSerial))
+			DispatchImpl(Hub, (std::index_sequence_for<TArgs...>*)nullptr);
+	}
+
+	template<typename... TArgs>
+	template<size_t... Is>
+	void TPostedMessage<TArgs...>::DispatchImpl(FMessageHub* Hub, std::index_sequence<Is...>*)
+	{
+		Hub->SendObjectMessage(MessageKey, SigSrc, std::get<Is>(Args)...);
+	}
+
+	template<typename... TArgs>
+	void TCoalescedMessage<TArgs...>::Dispatch(FMessageHub* Hub)
+	{
+		// the source was destroyed before the flush
+		if (SigSrc.TryGetUObject() && !WeakSrc.IsValid())
+			return;
+
+		for (int32 Idx = 0; Idx < Args.Num(); ++Idx)
+		{
+			if (!HasStaleObjectArgs(WeakArgs[Idx]))
+				DispatchImpl(Hub, Args[Idx], (std::index_sequence_for<TArgs...>*)nullptr);
+		}
+	}
+
+	template<typename... TArgs>
+	template<size_t... Is>
+	void TCoalescedMessage<TArgs...>::DispatchImpl(FMessageHub* Hub, std::tuple<TArgs...>& InArgs, std::index_sequence<Is...>*)
+	{
+		Hub->SendObjectMessage(MessageKey, SigSrc, std::get<Is>(InArgs)...);
+	}
 }  // namespace Hub
 }  // namespace GMP
 
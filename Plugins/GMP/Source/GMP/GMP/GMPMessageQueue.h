@@ -0,0 +1,56 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+namespace GMP
+{
+// multi-producer single-consumer ring of posted messages, producers may be on any thread and the game thread drains it
+class GMP_API FPostedMessageQueue
+{
+public:
+	// bDispatch is false when the queue is dropped, the payload must be destructed in both cases
+	using FDispatchFunc = void (*)(void* Payload, bool bDispatch);
+	static constexpr uint32 RecordAlignment = 16;
+
+	static FPostedMessageQueue& Get();
+
+	template<typename TPayload, typename... TArgs>
+	bool Enqueue(TArgs&&... Args)
+	{
+		static_assert(alignof(TPayload) <= RecordAlignment, "over-aligned payload");
+		void* Mem = Reserve(sizeof(TPayload));
+		if (!Mem)
+			return false;
+
+		new (Mem) TPayload(std::forward<TArgs>(Args)...);
+		Commit(Mem, [](void* Ptr, bool bDispatch) {
+			auto Payload = static_cast<TPayload*>(Ptr);
+			if (bDispatch)
+				Payload->Dispatch();
+			Payload->~TPayload();
+		});
+		return true;
+	}
+
+	// game thread only, returns the number of dispatched messages
+	int32 Drain();
+	bool IsEmpty() const { return Head.load(std::memory_order_acquire) == Tail.load(std::memory_order_acquire); }
+
+	~FPostedMessageQueue();
+
+private:
+	FPostedMessageQueue();
+	void* Reserve(uint32 PayloadSize);
+	void Commit(void* Payload, FDispatchFunc Func);
+
+	uint8* Buffer = nullptr;
+	uint64 Capacity = 0;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Head{0};
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Tail{0};
+	std::atomic<int32> DroppedNum{0};
+	bool bDraining = false;
+};
+}  // namespace GMP
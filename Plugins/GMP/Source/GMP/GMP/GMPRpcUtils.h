@@ -19,12 +19,15 @@ class GMP_API FRpcMessageUtils
 protected:
 	static UPackageMap* GetPackageMap(APlayerController* PC);
 	static const int32 GetMaxBytes();
-	static void PostRPCMsg(APlayerController* PC, UObject* Sender, const FString& MessageStr, TArray<uint8>& Buffer, bool Reliable = true);
+	static void PostRPCMsg(APlayerController* PC, UObject* Sender, FName MessageName, TArray<uint8>& Buffer, bool Reliable = true);
 	static FString ProxyGetNameSafe(APlayerController* PC);
 	static APlayerController* GetLocalPC(UObject* Obj);
 	static int32 GetPlayerLocalSequence(const APlayerController& PC);
 
 	static bool Z_VerifyRPC(APlayerController* PC, const UObject* Obj, const FMSGKEY& MessageKey, const TArray<FProperty*>& Props);
+	// whether serializing these properties resolves objects through the package map of a connection
+	static bool NeedsPackageMap(const TArray<FProperty*>& Props);
+	static void GetPlayerControllers(UWorld* World, TArray<APlayerController*>& OutPCs);
 
 	template<typename T, typename... TArgs>
 	static void Z_PostRPC(bool bReliable, APlayerController* PC, T* Sender, const FMSGKEY& MessageKey, TArgs&... InArgs)
@@ -52,13 +55,73 @@ protected:
 			{
 				FGMPNetBitWriter Writer(Package, 0);
 				Serializer::NetSerializeWithProps(Package, Writer, Properties, ((std::remove_cv_t<TArgs>&)InArgs)...);
-				ensure(Writer.GetNumBits() <= GetMaxBytes() * 8);
 				if (ensureAlways(!Writer.IsError()))
-					PostRPCMsg(PC, Sender, MessageKey.ToString(), const_cast<TArray<uint8>&>(*Writer.GetBuffer()), bReliable);
+					PostRPCMsg(PC, Sender, MessageKey, const_cast<TArray<uint8>&>(*Writer.GetBuffer()), bReliable);
 			}
 		}
 	}
 
+	// payloads are written once per package map when they hold object references, once in total otherwise
+	template<typename T, typename... TArgs>
+	static void Z_MulticastRPC(bool bReliable, TArrayView<APlayerController* const> PCs, T* Sender, const FMSGKEY& MessageKey, TArgs&... InArgs)
+	{
+		using MyTraits = Class2Prop::TPropertiesTraits<std::decay_t<TArgs>...>;
+		static auto Properties = MyTraits::GetProperties();
+		static const bool bNeedsPackageMap = NeedsPackageMap(Properties);
+		if (PCs.Num() == 0)
+			return;
+
+#if WITH_EDITOR
+		bool bSucc = Z_VerifyRPC(PCs[0], Sender, MessageKey, Properties);
+		if (!ensureAlways(bSucc))
+			return;
+		bool bLocalSent = false;
+#endif
+
+		struct FPayload
+		{
+			UPackageMap* Package;
+			TArray<uint8> Buffer;
+		};
+		TArray<FPayload, TInlineAllocator<4>> Payloads;
+		TArray<uint8> Buffer;
+		for (APlayerController* PC : PCs)
+		{
+			if (!PC)
+				continue;
+
+			auto Package = FRpcMessageUtils::GetPackageMap(PC);
+#if WITH_EDITOR
+			if (!Package || Package->GetWorld()->GetNetMode() == NM_Standalone)
+			{
+				if (!bLocalSent)
+					FMessageUtils::GetMessageHub()->SendObjectMessage(MessageKey, Sender, InArgs...);
+				bLocalSent = true;
+				continue;
+			}
+#endif
+#if !WITH_SERVER_CODE
+			if (!ensureAlwaysMsgf(Package, TEXT("null map in MulticastRPC: PC:%s Obj:%s Key:%s"), *ProxyGetNameSafe(PC), *GetNameSafe(Sender), *MessageKey.ToString()))
+				continue;
+#endif
+			// as in Z_PostRPC, local controllers of a listen server have no map and are written without one
+
+			FPayload* Payload = Payloads.FindByPredicate([&](const FPayload& Elem) { return !bNeedsPackageMap || Elem.Package == Package; });
+			if (!Payload)
+			{
+				FGMPNetBitWriter Writer(Package, 0);
+				Serializer::NetSerializeWithProps(Package, Writer, Properties, ((std::remove_cv_t<TArgs>&)InArgs)...);
+				if (!ensureAlways(!Writer.IsError()))
+					return;
+				Payload = &Add_GetRef(Payloads, FPayload{Package, *Writer.GetBuffer()});
+			}
+
+			// proxies may take ownership of the buffer they are given
+			Buffer = Payload->Buffer;
+			PostRPCMsg(PC, Sender, MessageKey, Buffer, bReliable);
+		}
+	}
+
 public:
 	template<typename T, typename... TArgs>
 	static FORCEINLINE void PostRPC(APlayerController* PC, T* Sender, const MSGKEY_TYPE& Key, const TArgs&... InArgs)
@@ -66,6 +129,22 @@ public:
 		Z_PostRPC(true, PC, Sender, Key, const_cast<TArgs&>(InArgs)...);
 	}
 
+	template<typename T, typename... TArgs>
+	static FORCEINLINE void MulticastRPC(TArrayView<APlayerController* const> PCs, T* Sender, const MSGKEY_TYPE& Key, const TArgs&... InArgs)
+	{
+		Z_MulticastRPC(true, PCs, Sender, Key, const_cast<TArgs&>(InArgs)...);
+	}
+
+	// sends to every player controller of the world accepted by Predicate(APlayerController*)
+	template<typename T, typename P, typename... TArgs>
+	static void MulticastRPCIf(UWorld* World, P&& Predicate, T* Sender, const MSGKEY_TYPE& Key, const TArgs&... InArgs)
+	{
+		TArray<APlayerController*> PCs;
+		GetPlayerControllers(World, PCs);
+		PCs.RemoveAllSwap([&](APlayerController* PC) { return !Predicate(PC); });
+		Z_MulticastRPC(true, PCs, Sender, Key, const_cast<TArgs&>(InArgs)...);
+	}
+
 	template<typename T, typename F>
 	static void RecvRPC(APlayerController* PC, const UObject* WatchedObj, const MSGKEY_TYPE& Key, T* Binder, F&& Func, int32 Times = -1)
 	{
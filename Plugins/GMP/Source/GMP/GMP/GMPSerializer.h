@@ -2,6 +2,7 @@
 
 #pragma once
 #include "GMPClass2Prop.h"
+#include "Templates/AndOrNot.h"
 #include "Templates/Invoke.h"
 #include "UObject/Class.h"
 
@@ -167,12 +168,75 @@ namespace Serializer
 		(void)(Temp);
 	}
 #endif
+	// arithmetic values are written as is by NetSerializeItem, so a pack made only of them can go out as one block of bits
+	// quantized floats/vectors are left out on purpose, receivers decode through the reflected properties of the signature
+	template<typename T>
+	struct TTraitsBulkPOD
+	{
+		enum
+		{
+			Value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+		};
+	};
+
 	template<typename... TArgs>
-	FORCEINLINE void NetSerializeWithProps(UPackageMap* Map, FArchive& Ar, const TArray<FProperty*>& Props, TArgs&... Args)
+	struct TBulkPackTraits
+	{
+		enum
+		{
+			value = sizeof...(TArgs) > 0 && TAnd<TTraitsBulkPOD<std::decay_t<TArgs>>...>::Value,
+		};
+
+		static constexpr size_t GetBytes()
+		{
+			size_t Sizes[] = {0, sizeof(TArgs)...};
+			size_t Sum = 0;
+			for (auto Size : Sizes)
+				Sum += Size;
+			return Sum;
+		}
+	};
+
+	template<typename... TArgs>
+	void NetSerializeBulk(FArchive& Ar, TArgs&... Args)
+	{
+		constexpr size_t Bytes = TBulkPackTraits<TArgs...>::GetBytes();
+		uint8 Packed[Bytes];
+		uint8* Cursor = Packed;
+		if (Ar.IsSaving())
+		{
+			int Temp[] = {0, (FMemory::Memcpy(Cursor, std::addressof(Args), sizeof(TArgs)), Cursor += sizeof(TArgs), 0)...};
+			(void)(Temp);
+		}
+		Ar.SerializeBits(Packed, Bytes * 8);
+		if (Ar.IsLoading() && !Ar.IsError())
+		{
+			int Temp[] = {0, (FMemory::Memcpy(std::addressof(Args), Cursor, sizeof(TArgs)), Cursor += sizeof(TArgs), 0)...};
+			(void)(Temp);
+		}
+	}
+
+	template<typename... TArgs>
+	FORCEINLINE void NetSerializePack(std::true_type, UPackageMap* Map, FArchive& Ar, const TArray<FProperty*>& Props, TArgs&... Args)
+	{
+		// byte swapping archives need the per value path
+		if (!Ar.IsByteSwapping())
+			NetSerializeBulk(Ar, Args...);
+		else
+			NetSerializeImpl(Map, Ar, Props, std::make_index_sequence<sizeof...(TArgs)>{}, Args...);
+	}
+	template<typename... TArgs>
+	FORCEINLINE void NetSerializePack(std::false_type, UPackageMap* Map, FArchive& Ar, const TArray<FProperty*>& Props, TArgs&... Args)
 	{
 		NetSerializeImpl(Map, Ar, Props, std::make_index_sequence<sizeof...(TArgs)>{}, Args...);
 	}
 
+	template<typename... TArgs>
+	FORCEINLINE void NetSerializeWithProps(UPackageMap* Map, FArchive& Ar, const TArray<FProperty*>& Props, TArgs&... Args)
+	{
+		NetSerializePack(std::integral_constant<bool, !!TBulkPackTraits<TArgs...>::value>{}, Map, Ar, Props, Args...);
+	}
+
 	template<typename... TArgs>
 	FORCEINLINE void NetSerialize(FArchive& Ar, TArgs&... Args)
 	{
@@ -11,6 +11,7 @@ namespace GMP
 {
 class FMessageHub;
 class FSignalStore;
+class FSignalImpl;
 struct GMP_API FSignalBase
 {
 	mutable TSharedPtr<FSignalStore> Store;
@@ -5,11 +5,13 @@
 #include "CoreUObject.h"
 
 #include "Algo/AnyOf.h"
+#include "GMPExecutor.h"
 #include "GMPSignals.inl"
 #include "Logging/LogMacros.h"
 #include "Misc/AssertionMacros.h"
 #include "Misc/ScopeExit.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "Templates/AndOrNot.h"
 #include "Templates/TypeCompatibleBytes.h"
 #include "Templates/UnrealTemplate.h"
 #include "UObject/WeakObjectPtr.h"
@@ -100,13 +102,24 @@ struct FSigElmData
 	int32 TestInvokable() { return Handler.IsStale(true) ? 0 : (Times > 0 ? Times-- : Times); }
 
 	auto GetGMPKey() const { return GMPKey; }
+	uint32 GetGeneration() const { return Generation; }
+	int32 GetPriority() const { return Priority; }
 
 protected:
 	FSigSource Source = FSigSource::NullSigSrc;
 	FWeakObjectPtr Handler;
 	FGMPKey GMPKey;
 	int32 Times = -1;
-	uint32 Padding;
+	// higher fires first, connections of equal priority fire in connection order
+	int32 Priority = 0;
+	// stamped when connected, a running fire skips the newer ones
+	uint32 Generation = 0;
+	// index in FSignalStore::SigElmSlots
+	int32 SlotIndex = INDEX_NONE;
+	// index in the bucket of its source
+	int32 BucketIndex = INDEX_NONE;
+	// bytes taken from FGMPSlabPool
+	uint32 AllocSize = 0;
 };
 
 #define SLOT_STORAGE_INLINE_SIZE GMP_ATTACHED_FUNCTION_ALIGN_SIZE
@@ -117,25 +130,28 @@ protected:
 
 class FSigElm final : public TAttachedCallableStore<FSigElmData, SLOT_STORAGE_INLINE_SIZE>
 {
-#if GMP_ALWAYS_USE_INLINE_SIGNAL
 public:
-	void* operator new(size_t Size, uint32 AdditionalSize)
+	struct FDeleter
 	{
-		auto AllocSize = FMath::Max(sizeof(FSigElm), offsetofINLINE() + FMath::Max((uint32)FStorageErase::kSLOT_STORAGE_INLINE_ALIGNMENT, AdditionalSize));
-		return FMemory::Malloc(AllocSize, alignof(FSigElm));
-	}
-	void operator delete(void* Ptr) { return FMemory::Free(Ptr); }
-
-#endif
+		void operator()(FSigElm* Ptr) const
+		{
+			const uint32 Size = Ptr->AllocSize;
+			Ptr->~FSigElm();
+			FGMPSlabPool::Free(Ptr, Size, alignof(FSigElm));
+		}
+	};
 
 private:
 	static FSigElm* Alloc(FGMPKey InKey, uint32 AdditionalSize = 0)
 	{
 #if GMP_ALWAYS_USE_INLINE_SIGNAL
-		return new (AdditionalSize) FSigElm(InKey);
+		const uint32 Size = FMath::Max((uint32)sizeof(FSigElm), (uint32)offsetofINLINE() + FMath::Max((uint32)FStorageErase::kSLOT_STORAGE_INLINE_ALIGNMENT, AdditionalSize));
 #else
-		return new FSigElm(InKey);
+		const uint32 Size = sizeof(FSigElm);
 #endif
+		FSigElm* Impl = new (FGMPSlabPool::Malloc(Size, alignof(FSigElm))) FSigElm(InKey);
+		Impl->AllocSize = Size;
+		return Impl;
 	}
 	using Super = TAttachedCallableStore<FSigElmData, SLOT_STORAGE_INLINE_SIZE>;
 
@@ -164,11 +180,13 @@ private:
 	FSigElm(FGMPKey InKey) { GMPKey = InKey; }
 	FSigElm(const FSigElm&) = delete;
 	FSigElm& operator=(const FSigElm&) = delete;
+	~FSigElm() = default;
 
 	friend class FSignalStore;
 	template<bool, typename...>
 	friend class TSignal;
 };
+using FSigElmPtr = TUniquePtr<FSigElm, FSigElm::FDeleter>;
 
 // clang-format off
 struct UseDefaultId {};
@@ -218,18 +236,61 @@ public:
 		return AddSigElmImpl(Key, InHandler, InSigSrc, Ctor);
 	}
 
+	// the connection moves to its place in the fire order when the next outermost fire begins or the running one returns
+	void SetPriority(FSigElm* SigElm, int32 Priority);
+
 private:
-	mutable TMap<FGMPKey, TUniquePtr<FSigElm>> SigElmMap;
-	FMsgKeyArray AnySrcSigKeys;
-	TMap<FGMPKey, TUniquePtr<FSigElm>>& GetStorageMap() const { return SigElmMap; }
+	// dense slots in priority then connection order once sorted, removed slots are left null until compacted
+	TArray<FSigElmPtr> SigElmSlots;
+	// a slot was added out of order or reprioritized, sorted before the next outermost fire or when the running one returns
+	bool bSlotsUnsorted = false;
+	// slots removed while firing, released when the outermost fire returns
+	TArray<FSigElmPtr> PendingKills;
+	TMap<FGMPKey, FSigElm*> SigElmMap;
+	uint32 SlotGeneration = 0;
+	int32 StaleSlots = 0;
+	int32 FiringDepth = 0;
+
+	// listeners of one source in priority then connection order, reordered entries wait for the next compaction
+	struct FSigElmBucket : public TArray<FSigElm*, TInlineAllocator<2>>
+	{
+		// removed entries left null, compacted once they are the half
+		int32 StaleNum = 0;
+	};
+	TMap<FSigSource, FSigElmBucket> SourceObjs;
+	FSigElmBucket AnySrcSigElms;
+	TArray<FSigSource> DirtyBuckets;
+	bool bAnySrcDirty = false;
+	// bumped whenever SourceObjs may have been rehashed
+	uint32 BucketVersion = 0;
+
 	using FSigElmPtrSet = TSet<FSigElm*, DefaultKeyFuncs<FSigElm*>, TInlineSetAllocator<1>>;
-	TMap<FSigSource, FSigElmPtrSet> SourceObjs;
 	mutable TMap<FWeakObjectPtr, FSigElmPtrSet> HandlerObjs;
 
+	FORCEINLINE const FSigElmBucket* FindBucket(FSigSource InSigSrc) const { return InSigSrc.SigOrObj() ? SourceObjs.Find(InSigSrc) : &AnySrcSigElms; }
+	void UnlinkSource(FSigElm* SigElm);
+	void UnlinkHandler(FSigElm* SigElm);
+	void CompactBuckets();
+	void CompactBucket(FSigElmBucket& Bucket, bool bResort = false);
+	FSigElmBucket* FindBucket(FSigSource InSigSrc) { return InSigSrc.SigOrObj() ? SourceObjs.Find(InSigSrc) : &AnySrcSigElms; }
+	void MarkBucketDirty(FSigSource InSigSrc);
+	void InsertSorted(FSigElmBucket& Bucket, FSigElm* SigElm);
+	void InsertSortedSlot(FSigElmPtr&& SigElm);
+	void SortSlots();
+	void SortIfDirty();
+
 	FSigElm* AddSigElmImpl(FGMPKey Key, const UObject* InHandler, FSigSource InSigSrc, const TGMPFunctionRef<FSigElm*()>& Ctor);
+	void RemoveSlot(FSigElm* SigElm);
+	void CompactSlots();
+	bool IsFiring() const { return FiringDepth > 0; }
 
+	// slot and serial in the source deleter table
+	uint64 StoreHandle = 0;
+
+	struct FFireScope;
 	friend struct FSignalUtils;
 	friend class FSignalImpl;
+	friend class FGMPSourceAndHandlerDeleter;
 };
 extern template auto FSignalStore::GetKeysBySrc<>(FSigSource InSigSrc) const;
 
@@ -238,6 +299,7 @@ class GMP_API FSignalImpl : public FSignalBase
 public:
 	static TSharedRef<FSignalStore> MakeSignals();
 	bool IsEmpty() const;
+	int32 Num() const;
 
 	template<typename... Ts>
 	auto IsAlive(const Ts... ts) const
@@ -248,6 +310,9 @@ public:
 
 	FORCEINLINE void DisconnectAll() { Disconnect(); }
 
+	// higher priorities fire first, changes are sorted in once before the next fire
+	void SetPriority(FGMPKey Key, int32 Priority);
+
 protected:
 	void Disconnect();
 	void Disconnect(FGMPKey Key);
@@ -315,17 +380,24 @@ protected:
 	using FOnFireResults = void;
 #endif
 
+	// stops once *bStopped is true, checked before each slot
+	template<bool bAllowDuplicate>
+	void OnFire(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped = nullptr) const;
+	// stops once *bStopped is true, checked before each slot, the slots of Merged are fired in the same priority order
 	template<bool bAllowDuplicate>
-	void OnFire(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+	FOnFireResults OnFireWithSigSource(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped = nullptr, TArrayView<const FSignalImpl* const> Merged = {}) const;
+	// fires the single connection of Key, false if it is gone
 	template<bool bAllowDuplicate>
-	FOnFireResults OnFireWithSigSource(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+	bool OnFireSlot(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
 };
 extern template GMP_API void FSignalImpl::DisconnectExactly<true>(const UObject* Listener, FSigSource InSigSrc);
 extern template GMP_API void FSignalImpl::DisconnectExactly<false>(const UObject* Listener, FSigSource InSigSrc);
-extern template GMP_API void FSignalImpl::OnFire<true>(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
-extern template GMP_API void FSignalImpl::OnFire<false>(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
-extern template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<true>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
-extern template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<false>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+extern template GMP_API void FSignalImpl::OnFire<true>(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped) const;
+extern template GMP_API void FSignalImpl::OnFire<false>(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped) const;
+extern template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<true>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped, TArrayView<const FSignalImpl* const> Merged) const;
+extern template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<false>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped, TArrayView<const FSignalImpl* const> Merged) const;
+extern template GMP_API bool FSignalImpl::OnFireSlot<true>(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+extern template GMP_API bool FSignalImpl::OnFireSlot<false>(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
 
 template<bool bAllowDuplicate, typename... TArgs>
 class TSignal final : public FSignalImpl
@@ -395,6 +467,43 @@ public:
 		return ConnectFunctor(Obj, std::forward<F>(Callable), &std::decay_t<F>::operator(), InSigSrc);
 	}
 
+	// non-inline targets receive the arguments as const refs into a copy shared by all of them, made once per fire
+	// the listener and the object arguments are kept alive until the task returns, a task disconnected before it runs is skipped
+	template<typename T, typename F>
+	FSigElm* Connect(T* const Obj, F&& Callable, FSigSource InSigSrc, FGMPExecTarget ExecTarget)
+	{
+		static_assert(TIsSupported<T>, "unsupported Obj type");
+		checkSlow(IsInGameThread() && (!std::is_base_of<FSigCollection, T>::value || Obj));
+		if (ExecTarget.IsInline())
+			return Connect(Obj, std::forward<F>(Callable), InSigSrc);
+
+		static_assert(TAnd<std::is_copy_constructible<std::decay_t<TArgs>>...>::Value, "arguments must be copyable");
+		auto Key = GetGMPKey(Callable);
+		auto SharedCallable = MakeShared<std::decay_t<F>, ESPMode::ThreadSafe>(std::forward<F>(Callable));
+		// the connection is only fired while its listener is alive
+		UObject* Listener = const_cast<UObject*>(static_cast<const UObject*>(ToUObject(Obj)));
+		return ConnectImpl(
+			HasCollectionBase<T>{},
+			Obj,
+			[SharedCallable, ExecTarget, Listener](ForwardParam<TArgs>... Args) {
+				auto& Payload = FFirePayloadScope::Current();
+				if (!Payload.IsValid())
+					Payload = MakeShared<const FPayloadTuple, ESPMode::ThreadSafe>(ForwardParam<TArgs>(Args)...);
+				FGMPExecTarget::FPinnedObjects Pinned;
+				if (Listener)
+					Pinned.Add(Listener);
+				AddPinnedObjects(Pinned, *Payload, std::index_sequence_for<TArgs...>());
+				ExecTarget.Execute(
+					[WeakCallable{TWeakPtr<std::decay_t<F>, ESPMode::ThreadSafe>(SharedCallable)}, Payload] {
+						if (auto Callable = WeakCallable.Pin())
+							ApplyPayload(*Callable, *Payload, std::index_sequence_for<TArgs...>());
+					},
+					MoveTemp(Pinned));
+			},
+			InSigSrc,
+			Key);
+	}
+
 #if GMP_SIGNAL_COMPATIBLE_WITH_BASEDELEGATE
 	template<typename T, typename R>
 	auto Connect(T* const Obj, TUnrealDelegate<R, TArgs...>&& Delegate, FSigSource InSigSrc = FSigSource::NullSigSrc)
@@ -410,18 +519,88 @@ public:
 
 	void Fire(TArgs... Args) const
 	{
+		FFirePayloadScope PayloadScope;
 		OnFire<bAllowDuplicate>([&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); });
 	}
 
+	// the remaining slots are skipped once bStopped turns true, Fire and FireWithSigSource always run every slot
+	void FireUntil(const bool& bStopped, TArgs... Args) const
+	{
+		FFirePayloadScope PayloadScope;
+		OnFire<bAllowDuplicate>([&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); }, &bStopped);
+	}
+
 	auto FireWithSigSource(FSigSource InSigSrc, TArgs... Args) const
 	{
+		FFirePayloadScope PayloadScope;
 		return OnFireWithSigSource<bAllowDuplicate>(InSigSrc, [&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); });
 	}
 
+	// the remaining slots are skipped once bStopped turns true
+	auto FireWithSigSourceUntil(FSigSource InSigSrc, const bool& bStopped, TArgs... Args) const
+	{
+		FFirePayloadScope PayloadScope;
+		return OnFireWithSigSource<bAllowDuplicate>(InSigSrc, [&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); }, &bStopped);
+	}
+
+	// fires the slots of Merged along with these by priority, ties go to these then to Merged in order
+	auto FireMergedUntil(TArrayView<const FSignalImpl* const> Merged, FSigSource InSigSrc, const bool& bStopped, TArgs... Args) const
+	{
+		FFirePayloadScope PayloadScope;
+		return OnFireWithSigSource<bAllowDuplicate>(InSigSrc, [&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); }, &bStopped, Merged);
+	}
+
+	bool FireSlot(FGMPKey Key, TArgs... Args) const
+	{
+		FFirePayloadScope PayloadScope;
+		return OnFireSlot<bAllowDuplicate>(Key, [&](FSigElm* Elem) { InvokeSlot(Elem, ForwardParam<TArgs>(Args)...); });
+	}
+
 	using FSignalImpl::Disconnect;
 	FORCEINLINE void Disconnect(const UObject* Listener, FSigSource InSigSrc) { FSignalImpl::DisconnectExactly<bAllowDuplicate>(Listener, InSigSrc); }
 
 private:
+	using FPayloadTuple = std::tuple<std::decay_t<TArgs>...>;
+	using FPayloadPtr = TSharedPtr<const FPayloadTuple, ESPMode::ThreadSafe>;
+
+	// the copy shared by the async slots of the current fire, saved and restored for nested fires
+	struct FFirePayloadScope
+	{
+		FFirePayloadScope() { Saved = MoveTemp(Current()); }
+		~FFirePayloadScope() { Current() = MoveTemp(Saved); }
+		static FPayloadPtr& Current()
+		{
+			static FPayloadPtr Payload;
+			return Payload;
+		}
+
+	private:
+		FPayloadPtr Saved;
+	};
+
+	template<typename F, size_t... Is>
+	static void ApplyPayload(const F& Func, const FPayloadTuple& Payload, std::index_sequence<Is...>)
+	{
+		Func(std::get<Is>(Payload)...);
+	}
+
+	template<typename T>
+	static std::enable_if_t<std::is_base_of<UObject, T>::value> AddPinnedObject(FGMPExecTarget::FPinnedObjects& Pinned, T* Obj, int)
+	{
+		if (Obj)
+			Pinned.AddUnique(const_cast<UObject*>(static_cast<const UObject*>(Obj)));
+	}
+	template<typename T>
+	static void AddPinnedObject(FGMPExecTarget::FPinnedObjects&, const T&, ...)
+	{
+	}
+	template<size_t... Is>
+	static void AddPinnedObjects(FGMPExecTarget::FPinnedObjects& Pinned, const FPayloadTuple& Payload, std::index_sequence<Is...>)
+	{
+		int Dummy[] = {0, (AddPinnedObject(Pinned, std::get<Is>(Payload), 0), 0)...};
+		(void)Dummy;
+	}
+
 	static void InvokeSlot(FSigElm* Item, TArgs... Args)
 	{
 		Item->CheckCallable();
@@ -134,6 +134,20 @@ inline FName ToMessageKey(uint32_t Key, EFindName FindType = FNAME_Add)
 {
 	return FName(*BytesToHex(reinterpret_cast<const uint8*>(&Key), sizeof(Key)), FindType);
 }
+
+// process-wide dense indices of message keys, an interned key keeps its index for the whole process
+struct GMP_API FMessageKeyIndex
+{
+	static int32 Intern(FName MessageKey);
+	static int32 Find(FName MessageKey);
+	static FName GetName(int32 Index);
+	// the key without its last dotted segment, INDEX_NONE for a root key
+	static int32 GetParent(int32 Index);
+	// appends the keys one dotted segment below
+	static void GetChildren(int32 Index, TArray<int32, TInlineAllocator<16>>& OutChildren);
+	static int32 Num();
+};
+
 template<EFindName EType>
 struct TMSGKEYBase : public FName
 {
@@ -143,7 +157,35 @@ struct TMSGKEYBase : public FName
 		: FName(ToMessageKey(In, EType))
 	{
 	}
+	template<EFindName EOther>
+	TMSGKEYBase(const TMSGKEYBase<EOther>& In)
+		: FName(In)
+		, MessageIndex(In.GetMessageIndex())
+	{
+	}
 	using FName::FName;
+
+	// INDEX_NONE if not resolved yet
+	FORCEINLINE int32 GetMessageIndex() const { return MessageIndex; }
+	// a found index is kept so later lookups with the same key skip the table
+	FORCEINLINE int32 ResolveMessageIndex() const
+	{
+		if (MessageIndex == INDEX_NONE)
+			MessageIndex = FMessageKeyIndex::Find(*this);
+		return MessageIndex;
+	}
+
+	static TMSGKEYBase MakeInterned(FName InName)
+	{
+		TMSGKEYBase Ret(InName);
+		Ret.MessageIndex = FMessageKeyIndex::Intern(InName);
+		return Ret;
+	}
+
+protected:
+	template<EFindName>
+	friend struct TMSGKEYBase;
+	mutable int32 MessageIndex = INDEX_NONE;
 };
 
 using FMSGKEY = TMSGKEYBase<FNAME_Add>;
@@ -477,9 +519,41 @@ namespace GMP
 {
 using FTypedAddresses = TArray<FGMPTypedAddr, TInlineAllocator<8>>;
 using FArrayTypeNames = TArray<FName, TInlineAllocator<8>>;
+// message arguments plus the optional body data slots(sigsource/msgid/seq/params), kept on the stack for script dispatch
+using FFullParameters = TArray<FGMPTypedAddr, TInlineAllocator<12>>;
+
+// immutable copy of the arguments of one send, shared by the listeners which run off the game thread
+struct GMP_API FMessagePayload
+{
+	virtual ~FMessagePayload() = default;
+
+	FTypedAddresses Params;
+	FName MessageId;
+	FSigSource SigSrc;
+	FGMPKey SequenceId;
+	// shallow bytes of the copy, heap data owned by the arguments is not counted
+	uint32 PayloadSize = 0;
+	// object pointer arguments of the copy, which does not keep them alive
+	TArray<FWeakObjectPtr, TInlineAllocator<2>> WeakObjects;
+
+	bool HasStaleObjects() const
+	{
+		return WeakObjects.ContainsByPredicate([](const FWeakObjectPtr& Weak) { return !Weak.IsValid(); });
+	}
+
+	// a private copy for listeners which take the arguments by mutable reference
+	virtual TSharedRef<FMessagePayload, ESPMode::ThreadSafe> Clone() const = 0;
+};
+using FMessagePayloadPtr = TSharedPtr<const FMessagePayload, ESPMode::ThreadSafe>;
 
 struct GMP_API FMessageBody
 {
+	struct FPayloadMaker
+	{
+		const void* Tuple = nullptr;
+		TSharedPtr<FMessagePayload, ESPMode::ThreadSafe> (*Make)(const void*) = nullptr;
+	};
+
 	template<typename... Ts>
 	static const FArrayTypeNames& MakeStaticNamesImpl()
 	{
@@ -487,6 +561,15 @@ struct GMP_API FMessageBody
 		return Ret;
 	}
 
+	// only stable within one process, identifies already verified signatures
+	static uint64 HashTypeNames(const FArrayTypeNames& TypeNames);
+	template<typename... Ts>
+	static uint64 MakeStaticSignatureHash()
+	{
+		static const uint64 Hash = HashTypeNames(MakeStaticNamesImpl<Ts...>());
+		return Hash;
+	}
+
 	FORCEINLINE auto GetSigSource() const { return CurSigSrc.TryGetUObject(); }
 
 	template<typename TargetType>
@@ -527,12 +610,14 @@ struct GMP_API FMessageBody
 	auto Parameters() const { return TArray<FGMPTypedAddr>(Params); }
 	auto Sequence() const { return SequenceId; }
 	auto& GetParams() { return Params; }
+	// no copy, only valid during the dispatch
+	TArrayView<const FGMPTypedAddr> GetParamsView() const { return TArrayView<const FGMPTypedAddr>(Params.GetData(), Params.Num()); }
 
 	bool IsSignatureCompatible(bool bCall, const FArrayTypeNames*& OldParams, bool bNativeCall = false);
 
-	TArray<FGMPTypedAddr> MakeFullParameters(uint8 BodyDataMask, int32& ReserveCnt) const
+	FFullParameters MakeFullParameters(uint8 BodyDataMask, int32& ReserveCnt) const
 	{
-		TArray<FGMPTypedAddr> Ret;
+		FFullParameters Ret;
 		Ret.Reserve(Params.Num() + 4);
 
 		if (BodyDataMask & (1 << 0))  // 0x1
@@ -588,6 +673,14 @@ struct GMP_API FMessageBody
 
 	static FGMPKey GetNextSequenceID();
 
+	// copies the arguments on first use, null when the sender can not copy them
+	FMessagePayloadPtr GetSharedPayload();
+
+	// listeners of lower priority and prefix listeners are skipped once a hub notification is consumed, requests still reach every listener
+	// signals fired outside the hub only stop through TSignal::FireUntil and the other *Until fires
+	void Consume() { bConsumed = true; }
+	bool IsConsumed() const { return bConsumed; }
+
 protected:
 	FMessageBody(FTypedAddresses& InParams, FName InName, FSigSource InSigSrc, FGMPKey Id = {})
 		: Params(InParams)
@@ -600,6 +693,15 @@ protected:
 	{
 	}
 
+	// listeners may write through the body, shared payloads are only passed to those which can not
+	explicit FMessageBody(FMessagePayload& Payload)
+		: Params(Payload.Params)
+		, MessageId(Payload.MessageId)
+		, CurSigSrc(Payload.SigSrc)
+		, SequenceId(Payload.SequenceId)
+	{
+	}
+
 	FMessageBody(const FMessageBody&) = delete;
 	FMessageBody& operator=(const FMessageBody&) = delete;
 
@@ -608,6 +710,9 @@ protected:
 	FSigSource CurSigSrc;
 
 	FGMPKey SequenceId;
+	FPayloadMaker PayloadMaker;
+	FMessagePayloadPtr SharedPayload;
+	bool bConsumed = false;
 	friend class FMessageHub;
 #if WITH_EDITOR
 	float GetTimeSeconds();
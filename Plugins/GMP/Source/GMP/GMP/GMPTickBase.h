@@ -62,7 +62,7 @@ private:
 			ProcessStep(bNext, std::conditional_t<std::is_same<RetType, bool>::value, std::true_type, std::false_type>{});
 
 			const double NextEndTime = GetNextEndTimePoint(CurTime, BeginTime, ++StepCnt);
-			if (!bNext && NextEndTime >= EndTime)
+			if (!bNext || NextEndTime >= EndTime)
 				break;
 		}
 		LastTime = CurTime;
@@ -10,8 +10,11 @@
 #endif
 
 #if GMP_WITH_STATIC_MSGKEY
-using MSGKEY_TYPE = FName;
-#define MSGKEY(str) GMP_MSGKEY_HOLDER<C_STRING_TYPE(str)>
+// resolved to a message index during static initialization
+template<typename T>
+const GMP::FMSGKEY GMP_MSGKEY_INDEX_HOLDER = GMP::FMSGKEY::MakeInterned(FName(T::Get()));
+using MSGKEY_TYPE = GMP::FMSGKEY;
+#define MSGKEY(str) GMP_MSGKEY_INDEX_HOLDER<C_STRING_TYPE(str)>
 #else
 struct MSGKEY_TYPE
 {
@@ -80,23 +83,23 @@ public:
 	}
 
 	template<typename T, typename F>
-	FORCEINLINE_DEBUGGABLE static FGMPKey ListenMessage(const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1)
+	FORCEINLINE_DEBUGGABLE static FGMPKey ListenMessage(const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
-		return GetMessageHub()->ListenObjectMessage(K, FSigSource::NullSigSrc, Listenner, Forward<F>(f), Times);
+		return GetMessageHub()->ListenObjectMessage(K, FSigSource::NullSigSrc, Listenner, Forward<F>(f), Times, ExecTarget);
 	}
 
 	template<typename T, typename F>
-	FORCEINLINE_DEBUGGABLE static FGMPKey ListenObjectMessage(FSigSource InSigSrc, const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1)
+	FORCEINLINE_DEBUGGABLE static FGMPKey ListenObjectMessage(FSigSource InSigSrc, const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
 		checkSlow(InSigSrc);
-		return GetMessageHub()->ListenObjectMessage(K, InSigSrc, Listenner, Forward<F>(f), Times);
+		return GetMessageHub()->ListenObjectMessage(K, InSigSrc, Listenner, Forward<F>(f), Times, ExecTarget);
 	}
 	
 	template<typename T, typename F>
-	FORCEINLINE_DEBUGGABLE static FGMPKey ListenWorldMessage(const UObject* WorldContext, const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1)
+	FORCEINLINE_DEBUGGABLE static FGMPKey ListenWorldMessage(const UObject* WorldContext, const MSGKEY_TYPE& K, T* Listenner, F&& f, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
 		checkSlow(IsValid(WorldContext));
-		return GetMessageHub()->ListenObjectMessage(K, WorldContext->GetWorld(), Listenner, Forward<F>(f), Times);
+		return GetMessageHub()->ListenObjectMessage(K, WorldContext->GetWorld(), Listenner, Forward<F>(f), Times, ExecTarget);
 	}
 
 	template<typename... TArgs>
@@ -127,6 +130,20 @@ public:
 		return GetMessageHub()->SendObjectMessage(K, WorldContext->GetWorld(), NoRef(Args)...);
 	}
 
+	// thread-safe, see FMessageHub::PostObjectMessage
+	template<typename... TArgs>
+	FORCEINLINE static bool PostObjectMessage(FSigSource InSigSrc, const FMSGKEY& K, TArgs&&... Args)
+	{
+		return GetMessageHub()->PostObjectMessage(K, InSigSrc, Forward<TArgs>(Args)...);
+	}
+
+	template<typename... TArgs>
+	FORCEINLINE static bool PostWorldMessage(const UObject* WorldContext, const FMSGKEY& K, TArgs&&... Args)
+	{
+		checkSlow(IsValid(WorldContext));
+		return GetMessageHub()->PostObjectMessage(K, WorldContext->GetWorld(), Forward<TArgs>(Args)...);
+	}
+
 #if GMP_MULTIWORLD_SUPPORT
 	// clang-format off
 	template<typename... TArgs>
@@ -159,9 +176,9 @@ public:
 
 public:
 	template<typename F>
-	FORCEINLINE_DEBUGGABLE static FGMPKey UnsafeListenMessage(const MSGKEY_TYPE& K, F&& f, int32 Times = -1)
+	FORCEINLINE_DEBUGGABLE static FGMPKey UnsafeListenMessage(const MSGKEY_TYPE& K, F&& f, int32 Times = -1, FGMPExecTarget ExecTarget = FGMPExecTarget::Inline())
 	{
-		return GetMessageHub()->ListenObjectMessage(K, FSigSource::NullSigSrc, GMP_LISTENER_ANY(), Forward<F>(f), Times);
+		return GetMessageHub()->ListenObjectMessage(K, FSigSource::NullSigSrc, GMP_LISTENER_ANY(), Forward<F>(f), Times, ExecTarget);
 	}
 
 	template<typename F>
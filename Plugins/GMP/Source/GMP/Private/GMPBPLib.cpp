@@ -203,6 +203,32 @@ static bool bLogGMPBPExecution = false;
 static FAutoConsoleVariableRef CVar_DrawAbilityVisualizer(TEXT("x.LogGMPBPExecution"), bLogGMPBPExecution, TEXT("log each gmp exectuion"), ECVF_Default);
 #endif
 
+// script delegates take the parameters by TArray ref, reuse one buffer per dispatch depth instead of allocating per message
+struct FScratchParameters
+{
+	FScratchParameters(TArrayView<const FGMPTypedAddr> InParams)
+	{
+		check(IsInGameThread());
+		// indirect so that nested dispatches growing the list never move a buffer still referenced by an outer delegate
+		static TIndirectArray<TArray<FGMPTypedAddr>> Buffers;
+		while (Buffers.Num() <= Depth)
+			Buffers.Add(new TArray<FGMPTypedAddr>());
+		Array = &Buffers[Depth++];
+		Array->Append(InParams.GetData(), InParams.Num());
+	}
+	~FScratchParameters()
+	{
+		Array->Reset();
+		--Depth;
+	}
+	TArray<FGMPTypedAddr>& Get() { return *Array; }
+
+private:
+	TArray<FGMPTypedAddr>* Array;
+	static int32 Depth;
+};
+int32 FScratchParameters::Depth = 0;
+
 }  // namespace GMP
 
 bool UGMPBPLib::UnlistenMessage(const FString& MessageId, UObject* Listener, UGMPManager* Mgr, UObject* Obj)
@@ -330,8 +356,8 @@ FGMPTypedAddr UGMPBPLib::ListenMessageByKey(FName MessageKey, const FGMPScriptDe
 				if (bLogGMPBPExecution)
 					GMP_LOG(TEXT("Execute %s"), *Delegate.ToString<UObject>());
 #endif
-				auto Arr = Msg.Parameters();
-				Delegate.ExecuteIfBound(Msg.GetSigSource(), Msg.MessageKey(), Msg.Sequence(), Arr);
+				FScratchParameters Scratch(Msg.GetParamsView());
+				Delegate.ExecuteIfBound(Msg.GetSigSource(), Msg.MessageKey(), Msg.Sequence(), Scratch.Get());
 			},
 			Times);
 		if (!Id)
@@ -512,7 +538,7 @@ static FGMPKey RequestMessageImpl(FGMPKey& RspKey, FName EventName, const FStrin
 			break;
 		}
 		auto RspLambda = [Sender, Function](FMessageBody& RspBody) {
-			TArray<FGMPTypedAddr> RspParams{RspBody.GetParams()};
+			auto RspParams = RspBody.GetParamsView();
 			if (bLogGMPBPExecution)
 				GMP_LOG(TEXT("Execute %s.%s"), *GetNameSafe(Sender), *Function->GetName());
 			int32 PropIdx = 0;
@@ -546,7 +572,7 @@ static FGMPKey RequestMessageImpl(FGMPKey& RspKey, FName EventName, const FStrin
 		};
 #else
 		auto RspLambda = [Sender, Function](FMessageBody& RspBody) {
-			TArray<FGMPTypedAddr> RspParams{RspBody.GetParams()};
+			auto RspParams = RspBody.GetParamsView();
 			UGMPBPLib::CallMessageFunction(Sender, Function, RspParams);
 		};
 #endif
@@ -856,7 +882,7 @@ DEFINE_FUNCTION(UGMPBPLib::execAddrToSet)
 
 //////////////////////////////////////////////////////////////////////////
 
-bool UGMPBPLib::MessageToArchive(FArchive& Ar, UFunction* Function, const TArray<FGMPTypedAddr>& Params, UPackageMap* PackageMap)
+bool UGMPBPLib::MessageToArchive(FArchive& Ar, UFunction* Function, TArrayView<const FGMPTypedAddr> Params, UPackageMap* PackageMap)
 {
 	check(Ar.IsSaving());
 	bool bSucc = true;
@@ -910,7 +936,7 @@ bool UGMPBPLib::ArchiveToFrame(FArchive& ArToLoad, UFunction* Function, void* Fr
 	return bSucc;
 }
 
-bool UGMPBPLib::MessageToFrame(UFunction* Function, void* FramePtr, const TArray<FGMPTypedAddr>& Params)
+bool UGMPBPLib::MessageToFrame(UFunction* Function, void* FramePtr, TArrayView<const FGMPTypedAddr> Params)
 {
 	using namespace GMP;
 	if (InitializeFunctionParameters(Function, FramePtr) < 0)
@@ -1120,7 +1146,7 @@ bool UGMPBPLib::CallEventDelegate(UObject* Obj, const FName EventName, const TAr
 	return false;
 }
 
-bool UGMPBPLib::CallMessageFunction(UObject* Obj, UFunction* Function, const TArray<FGMPTypedAddr>& Params)
+bool UGMPBPLib::CallMessageFunction(UObject* Obj, UFunction* Function, TArrayView<const FGMPTypedAddr> Params)
 {
 	using namespace GMP;
 	if (!ensureAlways(Obj && Function))
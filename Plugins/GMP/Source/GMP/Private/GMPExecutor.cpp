@@ -0,0 +1,227 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#include "GMPExecutor.h"
+
+#include "Async/Async.h"
+#include "GMPTypeTraits.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/IQueuedWork.h"
+#include "Misc/QueuedThreadPool.h"
+#include "UObject/GCObject.h"
+#include "UnrealCompatibility.h"
+
+namespace GMP
+{
+namespace Executor
+{
+	struct FPoolEntry
+	{
+		FName Name;
+		FQueuedThreadPool* Pool = nullptr;
+		bool bOwned = false;
+	};
+
+	// slots are never reused so a stale FGMPExecTarget can not reach another pool
+	static TArray<FPoolEntry>& GetPools()
+	{
+		static TArray<FPoolEntry> Pools;
+		return Pools;
+	}
+
+	static int32 FindPool(FName PoolName)
+	{
+		return GetPools().IndexOfByPredicate([&](const FPoolEntry& Entry) { return Entry.Pool && Entry.Name == PoolName; });
+	}
+
+	static bool AddPool(FName PoolName, FQueuedThreadPool* Pool, bool bOwned)
+	{
+		check(IsInGameThread());
+		auto& Pools = GetPools();
+		if (!ensureMsgf(FindPool(PoolName) == INDEX_NONE, TEXT("GMP thread pool %s already registered"), *PoolName.ToString()) || !ensure(Pools.Num() < MAX_uint8))
+			return false;
+
+		if (TrueOnFirstCall([] {}))
+		{
+			FCoreDelegates::OnPreExit.AddLambda([] {
+				for (auto& Entry : GetPools())
+				{
+					if (Entry.bOwned && Entry.Pool)
+					{
+						Entry.Pool->Destroy();
+						delete Entry.Pool;
+					}
+					Entry.Pool = nullptr;
+				}
+			});
+		}
+
+		Pools.Add(FPoolEntry{PoolName, Pool, bOwned});
+		return true;
+	}
+
+	// unlike AsyncPool, an abandoned task is still destroyed so whatever it holds is released
+	class FQueuedTask final : public IQueuedWork
+	{
+	public:
+		explicit FQueuedTask(TUniqueFunction<void()>&& InTask)
+			: Task(MoveTemp(InTask))
+		{
+		}
+		virtual void DoThreadedWork() override
+		{
+			Task();
+			delete this;
+		}
+		virtual void Abandon() override { delete this; }
+
+	private:
+		TUniqueFunction<void()> Task;
+	};
+
+	// objects used by tasks off the game thread, counted so one object can be pinned by several tasks
+	class FObjectPins final : public FGCObject
+	{
+	public:
+		static FObjectPins& Get()
+		{
+			static FObjectPins Pins;
+			return Pins;
+		}
+
+		void Pin(const FGMPExecTarget::FPinnedObjects& Objs)
+		{
+			check(IsInGameThread());
+			for (auto Obj : Objs)
+				++Counts.FindOrAdd(Obj);
+		}
+		void Unpin(const FGMPExecTarget::FPinnedObjects& Objs)
+		{
+			check(IsInGameThread());
+			for (auto Obj : Objs)
+			{
+				auto Find = Counts.Find(Obj);
+				if (Find && --*Find <= 0)
+					Counts.Remove(Obj);
+			}
+		}
+
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override { Collector.AddReferencedObjects(Counts); }
+		virtual FString GetReferencerName() const override { return TEXT("GMPExecObjectPins"); }
+
+	private:
+		TMap<UObject*, int32> Counts;
+	};
+
+	// owned by the task, the pins go when the task is destroyed whether it ran or not
+	struct FPinScope
+	{
+		explicit FPinScope(FGMPExecTarget::FPinnedObjects&& InObjs)
+			: Objs(MoveTemp(InObjs))
+		{
+			if (Objs.Num())
+				FObjectPins::Get().Pin(Objs);
+		}
+		FPinScope(FPinScope&& Other)
+			: Objs(MoveTemp(Other.Objs))
+		{
+			Other.Objs.Reset();
+		}
+		FPinScope(const FPinScope&) = delete;
+		~FPinScope()
+		{
+			if (!Objs.Num())
+				return;
+			if (IsInGameThread())
+				FObjectPins::Get().Unpin(Objs);
+			else
+				AsyncTask(ENamedThreads::GameThread, [Objs{MoveTemp(Objs)}] { FObjectPins::Get().Unpin(Objs); });
+		}
+
+	private:
+		FGMPExecTarget::FPinnedObjects Objs;
+	};
+}  // namespace Executor
+
+FGMPExecTarget FGMPExecTarget::ThreadPool(FName PoolName)
+{
+	const int32 Index = Executor::FindPool(PoolName);
+	if (!ensureMsgf(Index != INDEX_NONE, TEXT("GMP thread pool %s not registered"), *PoolName.ToString()))
+		return TaskGraph();
+	return FGMPExecTarget(EGMPExecType::ThreadPool, static_cast<uint8>(Index));
+}
+
+bool FGMPExecTarget::RegisterPool(FName PoolName, int32 NumThreads, EThreadPriority Priority)
+{
+	FQueuedThreadPool* Pool = FQueuedThreadPool::Allocate();
+	if (!Pool->Create(FMath::Max(NumThreads, 1), 96 * 1024, Priority))
+	{
+		delete Pool;
+		return false;
+	}
+	if (Executor::AddPool(PoolName, Pool, true))
+		return true;
+
+	Pool->Destroy();
+	delete Pool;
+	return false;
+}
+
+bool FGMPExecTarget::RegisterPool(FName PoolName, FQueuedThreadPool* ExternalPool)
+{
+	return ensure(ExternalPool) && Executor::AddPool(PoolName, ExternalPool, false);
+}
+
+void FGMPExecTarget::UnregisterPool(FName PoolName)
+{
+	check(IsInGameThread());
+	const int32 Index = Executor::FindPool(PoolName);
+	if (Index == INDEX_NONE)
+		return;
+
+	auto& Entry = Executor::GetPools()[Index];
+	if (Entry.bOwned)
+	{
+		// waits for running tasks and abandons the queued ones, which releases their pins
+		Entry.Pool->Destroy();
+		delete Entry.Pool;
+	}
+	Entry.Pool = nullptr;
+}
+
+void FGMPExecTarget::Execute(TUniqueFunction<void()>&& Task) const
+{
+	switch (Type)
+	{
+		case EGMPExecType::ThreadPool:
+		{
+			checkSlow(IsInGameThread());
+			auto& Pools = Executor::GetPools();
+			if (Pools.IsValidIndex(PoolIndex) && Pools[PoolIndex].Pool)
+			{
+				Pools[PoolIndex].Pool->AddQueuedWork(new Executor::FQueuedTask(MoveTemp(Task)));
+				break;
+			}
+			GMP_WARNING(TEXT("GMP thread pool unregistered, fall back to task graph"));
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, MoveTemp(Task));
+			break;
+		}
+		case EGMPExecType::TaskGraph:
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, MoveTemp(Task));
+			break;
+		default:
+			Task();
+			break;
+	}
+}
+
+void FGMPExecTarget::Execute(TUniqueFunction<void()>&& Task, FPinnedObjects&& PinnedObjs) const
+{
+	checkSlow(IsInGameThread());
+	if (IsInline() || !PinnedObjs.Num())
+	{
+		Execute(MoveTemp(Task));
+		return;
+	}
+	Execute([Task{MoveTemp(Task)}, Pins{Executor::FPinScope(MoveTemp(PinnedObjs))}]() mutable { Task(); });
+}
+}  // namespace GMP
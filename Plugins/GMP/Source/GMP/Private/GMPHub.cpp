@@ -6,12 +6,17 @@
 
 #include "Algo/BinarySearch.h"
 #include "Algo/ForEach.h"
+#include "Engine/Engine.h"
+#include "Engine/EngineBaseTypes.h"
 #include "Engine/UserDefinedStruct.h"
+#include "Engine/World.h"
 #include "GMPMeta.h"
 #include "GMPSignalsImpl.h"
 #include "GMPSignalsInc.h"
 #include "GMPWorldLocals.h"
+#include "Misc/CoreDelegates.h"
 #include "Misc/ScopeExit.h"
+#include "Misc/ScopeRWLock.h"
 #include "UObject/ObjectKey.h"
 #include "UObject/TextProperty.h"
 #include "UObject/UObjectGlobals.h"
@@ -30,6 +35,118 @@ namespace GMP
 {
 using FGMPMsgSignal = TSignal<false, FMessageBody&>;
 
+namespace Hub
+{
+	struct FMessageKeyTable
+	{
+		FRWLock Lock;
+		TMap<FName, int32> Indices;
+		TArray<FName> Names;
+		// dotted hierarchy of the interned keys like the message tag nodes, parents are interned with their children
+		TArray<int32> Parents;
+		TArray<TArray<int32, TInlineAllocator<2>>> Children;
+		std::atomic<int32> InternedNum{0};
+
+		// game thread copy of the interned indices read without the lock, misses are not kept so it stays bounded by the interned keys
+		TMap<FName, int32> GameThreadIndices;
+		int32 CachedNum = 0;
+
+		int32 FindLocked(FName MessageKey)
+		{
+			FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+			auto Find = Indices.Find(MessageKey);
+			return Find ? *Find : INDEX_NONE;
+		}
+
+		int32 InternLocked(FName MessageKey)
+		{
+			if (auto Find = Indices.Find(MessageKey))
+				return *Find;
+
+			int32 ParentIndex = INDEX_NONE;
+			const FString Key = MessageKey.ToString();
+			int32 DotIdx = INDEX_NONE;
+			if (Key.FindLastChar(TEXT('.'), DotIdx) && DotIdx > 0)
+				ParentIndex = InternLocked(FName(*Key.Left(DotIdx)));
+
+			const int32 Index = Names.Add(MessageKey);
+			Indices.Add(MessageKey, Index);
+			Parents.Add(ParentIndex);
+			Children.AddDefaulted();
+			if (ParentIndex != INDEX_NONE)
+				Children[ParentIndex].Add(Index);
+			return Index;
+		}
+	};
+	static FMessageKeyTable& GetMessageKeyTable()
+	{
+		static FMessageKeyTable Table;
+		return Table;
+	}
+}  // namespace Hub
+
+int32 FMessageKeyIndex::Intern(FName MessageKey)
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	{
+		FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+		if (auto Find = Table.Indices.Find(MessageKey))
+			return *Find;
+	}
+
+	FRWScopeLock WriteLock(Table.Lock, SLT_Write);
+	const int32 Index = Table.InternLocked(MessageKey);
+	Table.InternedNum.store(Table.Names.Num(), std::memory_order_release);
+	return Index;
+}
+
+int32 FMessageKeyIndex::Find(FName MessageKey)
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	if (!IsInGameThread())
+		return Table.FindLocked(MessageKey);
+
+	// the copy holds every interned key once it caught up, a miss needs no lock
+	if (Table.CachedNum != Table.InternedNum.load(std::memory_order_acquire))
+	{
+		FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+		for (int32 Idx = Table.CachedNum; Idx < Table.Names.Num(); ++Idx)
+			Table.GameThreadIndices.Add(Table.Names[Idx], Idx);
+		Table.CachedNum = Table.Names.Num();
+	}
+	auto Cached = Table.GameThreadIndices.Find(MessageKey);
+	return Cached ? *Cached : INDEX_NONE;
+}
+
+FName FMessageKeyIndex::GetName(int32 Index)
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+	return Table.Names.IsValidIndex(Index) ? Table.Names[Index] : NAME_None;
+}
+
+int32 FMessageKeyIndex::GetParent(int32 Index)
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+	return Table.Parents.IsValidIndex(Index) ? Table.Parents[Index] : INDEX_NONE;
+}
+
+void FMessageKeyIndex::GetChildren(int32 Index, TArray<int32, TInlineAllocator<16>>& OutChildren)
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+	if (Table.Children.IsValidIndex(Index))
+		OutChildren.Append(Table.Children[Index]);
+}
+
+int32 FMessageKeyIndex::Num()
+{
+	auto& Table = Hub::GetMessageKeyTable();
+	FRWScopeLock ReadLock(Table.Lock, SLT_ReadOnly);
+	return Table.Names.Num();
+}
+
 #if GMP_DEBUGGAME
 static TSet<FName> TracedKeys;
 FAutoConsoleCommand CVAR_GMPTraceMessageKey(TEXT("GMP.TraceMessageKey"), TEXT("TraceMessageKey Arr(space splitted)"), FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
@@ -155,6 +272,36 @@ namespace Hub
 		return Types;
 	}
 
+	// bumped whenever the registered types change, a check that bumped it drops the verifications of its message id
+	static uint32 SignatureVersion = 1;
+	struct FVerifiedSignature
+	{
+		uint64 Hash;
+		bool bCall;
+	};
+	using FVerifiedSignatures = TArray<FVerifiedSignature, TInlineAllocator<2>>;
+	static TMap<FName, FVerifiedSignatures>& GetVerifiedSignatures()
+	{
+		static TMap<FName, FVerifiedSignatures> Verified;
+		return Verified;
+	}
+	static void ResetSignatures()
+	{
+		GetSends<true>().Empty();
+		GetRecvs<true>().Empty();
+		GetSends<false>().Empty();
+		GetRecvs<false>().Empty();
+		GetVerifiedSignatures().Empty();
+		++SignatureVersion;
+	}
+
+	static int32 RetainedMaxEntries = 1024;
+	FAutoConsoleVariableRef CVar_RetainedMaxEntries(TEXT("GMP.RetainedMaxEntries"), RetainedMaxEntries, TEXT("max retained message payloads of each hub and each of its world shards"));
+	static int32 RetainedMaxKB = 1024;
+	FAutoConsoleVariableRef CVar_RetainedMaxKB(TEXT("GMP.RetainedMaxKB"), RetainedMaxKB, TEXT("max KB of retained message payloads of each hub and each of its world shards, shallow sizes"));
+	// orders payloads across the stores of all hubs and world shards
+	static uint64 RetainedSerial = 0;
+
 	FMessageHub::CallbackMapType& GMPResponses(const UObject* WorldContextObj = nullptr) { return WorldLocalObject<FMessageHub::CallbackMapType>(WorldContextObj); }
 
 }  // namespace Hub
@@ -167,6 +314,70 @@ FGMPKey FMessageBody::GetNextSequenceID()
 	return FGMPKey(FPlatformAtomics::InterlockedAdd(&Seq, 1));
 }
 
+FMessagePayloadPtr FMessageBody::GetSharedPayload()
+{
+	if (!SharedPayload.IsValid() && PayloadMaker.Make)
+	{
+		auto Payload = PayloadMaker.Make(PayloadMaker.Tuple);
+		Payload->MessageId = MessageId;
+		Payload->SigSrc = CurSigSrc;
+		Payload->SequenceId = SequenceId;
+		SharedPayload = MoveTemp(Payload);
+		PayloadMaker = {};
+	}
+	return SharedPayload;
+}
+
+FGMPMessageSig FMessageHub::MakeAsyncCallback(FGMPExecTarget ExecTarget, FGMPMessageSig&& Func, const UObject* Listener, bool bMutableArgs)
+{
+	auto SharedFunc = MakeShared<FGMPMessageSig, ESPMode::ThreadSafe>(MoveTemp(Func));
+	return [ExecTarget, SharedFunc, WeakListener{FWeakObjectPtr(Listener)}, bHasListener{!!Listener}, bMutableArgs](FMessageBody& Body) {
+		auto Payload = Body.GetSharedPayload();
+		if (!Payload.IsValid())
+		{
+			GMP_WARNING(TEXT("FMessageHub::MakeAsyncCallback Key[%s] has no shared payload, run inline"), *Body.MessageKey().ToString());
+			(*SharedFunc)(Body);
+			return;
+		}
+
+		FGMPExecTarget::FPinnedObjects Pinned;
+		if (bHasListener)
+		{
+			UObject* ListenerObj = WeakListener.Get();
+			if (!ListenerObj)
+				return;
+			Pinned.Add(ListenerObj);
+		}
+		for (auto& Weak : Payload->WeakObjects)
+		{
+			if (UObject* Obj = Weak.Get())
+				Pinned.Add(Obj);
+		}
+
+		// a listener disconnected before its task runs is skipped
+		ExecTarget.Execute(
+			[WeakFunc{TWeakPtr<FGMPMessageSig, ESPMode::ThreadSafe>(SharedFunc)}, Payload, bMutableArgs] {
+				auto Func = WeakFunc.Pin();
+				if (!Func.IsValid())
+					return;
+				if (bMutableArgs)
+				{
+					// the shared copy is only read here, the listener writes to its own
+					auto Copy = Payload->Clone();
+					FMessageBody PayloadBody(*Copy);
+					(*Func)(PayloadBody);
+				}
+				else
+				{
+					// the listener takes no mutable reference, so the copy shared with other tasks is not written
+					FMessageBody PayloadBody(const_cast<FMessagePayload&>(*Payload));
+					(*Func)(PayloadBody);
+				}
+			},
+			MoveTemp(Pinned));
+	};
+}
+
 FMessageBody* FMessageHub::GetCurrentMessageBody() const
 {
 	return MessageBodyStack.Num() ? MessageBodyStack.Last() : nullptr;
@@ -195,9 +406,64 @@ struct FMessageHubVerifier
 #endif
 
 static TSet<FMessageHub*> MessageHubs;
+static FAutoConsoleCommandWithOutputDevice CVar_DumpRetainedMessages(TEXT("GMP.DumpRetainedMessages"), TEXT("list retained message payloads of every hub"), FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar) {
+																	 for (auto Hub : MessageHubs)
+																		 Hub->DumpRetained(Ar);
+																 }));
+
+struct FMessageHub::FWorldShard
+{
+	FWorldShard(UWorld* InWorld)
+		: World(InWorld)
+		, WeakWorld(InWorld)
+	{
+	}
+	// a released world may be collected and its address reused within the frame
+	FORCEINLINE bool IsFor(const UWorld* InWorld) const { return World == InWorld && WeakWorld.Get(true) == InWorld; }
+
+	const UWorld* World;
+	TWeakObjectPtr<const UWorld> WeakWorld;
+	bool bReleased = false;
+
+	FGMPSignalMap MessageSignals;
+	FPrefixListeners PrefixListeners;
+	FRetainedStore RetainedValues;
+	FCoalescedQueue CoalescedQueue;
+	CallbackMapType Responses;
+};
+
+template<typename F>
+void FMessageHub::ForEachWorldShard(const UObject* WorldContextObj, const F& Func) const
+{
+	if (!HasWorldShards())
+		return;
+
+	if (const UWorld* World = WorldContextObj ? WorldContextObj->GetWorld() : nullptr)
+	{
+		for (auto& Shard : WorldShards)
+		{
+			if (Shard->IsFor(World))
+			{
+				Func(Shard.Get());
+				return;
+			}
+		}
+		return;
+	}
+
+	// listeners may add shards while firing, they are only removed at the end of the frame
+	TArray<FWorldShard*, TInlineAllocator<4>> Shards;
+	for (auto& Shard : WorldShards)
+		Shards.Add(Shard.Get());
+	for (auto Shard : Shards)
+		Func(Shard);
+}
+
 FMessageHub::FMessageHub()
 {
 	FMessageHubVerifier Verifier{this};
+	static uint32 NextHubSerial = 0;
+	HubSerial = ++NextHubSerial;
 	MessageHubs.Add(this);
 }
 
@@ -213,9 +479,31 @@ bool FMessageHub::IsValidHub() const
 	return MessageHubs.Contains(this);
 }
 
+FMessageHub* FMessageHub::FindHub(uint32 InHubSerial)
+{
+	FMessageHubVerifier Verifier{nullptr};
+	for (auto Hub : MessageHubs)
+	{
+		if (Hub->HubSerial == InHubSerial)
+			return Hub;
+	}
+	return nullptr;
+}
+
 bool FMessageHub::IsResponseOn(FGMPKey Key) const
 {
-	return Hub::GMPResponses().Contains(Key);
+	if (Hub::GMPResponses().Contains(Key))
+		return true;
+	bool bFound = false;
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { bFound = bFound || Shard->Responses.Contains(Key); });
+	return bFound;
+}
+
+// a request from a source in a game world waits for its response within that world
+FMessageHub::CallbackMapType& FMessageHub::GetResponses(FSigSource InSigSrc)
+{
+	auto Shard = FindOrAddShard(InSigSrc);
+	return Shard ? Shard->Responses : Hub::GMPResponses();
 }
 
 void FMessageHub::PushMsgBody(FMessageBody* Body)
@@ -230,9 +518,9 @@ FMessageBody* FMessageHub::PopMsgBody()
 
 FGMPKey FMessageHub::RequestMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Param, FResponeSig&& OnRsp, const FArrayTypeNames* SingleshotTypes)
 {
-	if (OnRsp && CallbackMarks.Contains(MessageKey) && ensureAlwaysMsgf(!Hub::GMPResponses().Contains(OnRsp.GetId()), TEXT("duplicate sequence %zu!"), OnRsp.GetId()))
+	if (Ptr && OnRsp && CallbackMarks.Contains(MessageKey) && ensureAlwaysMsgf(!IsResponseOn(OnRsp.GetId()), TEXT("duplicate sequence %zu!"), OnRsp.GetId()))
 	{
-		Hub::GMPResponses().Emplace(OnRsp.GetId(), MoveTemp(OnRsp));
+		GetResponses(InSigSrc).Emplace(OnRsp.GetId(), MoveTemp(OnRsp));
 
 		FMessageBody Msg(Param, MessageKey, InSigSrc, OnRsp.GetId());
 
@@ -264,7 +552,10 @@ FGMPKey FMessageHub::RequestMessageImpl(FSignalBase* Ptr, const FName& MessageKe
 void FMessageHub::ResponseMessageImpl(bool bNativeCall, FGMPKey RequestSequence, FTypedAddresses& Params, const FArrayTypeNames* SingleshotTypes, FSigSource InSigSrc)
 {
 	FResponeSig Val;
-	if (Hub::GMPResponses().RemoveAndCopyValue(RequestSequence.Key, Val))
+	bool bFound = Hub::GMPResponses().RemoveAndCopyValue(RequestSequence.Key, Val);
+	if (!bFound)
+		ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { bFound = bFound || Shard->Responses.RemoveAndCopyValue(RequestSequence.Key, Val); });
+	if (bFound)
 	{
 #if GMP_WITH_DYNAMIC_CALL_CHECK
 		const FArrayTypeNames* OldParams = nullptr;
@@ -294,12 +585,98 @@ void FMessageHub::ResponseMessageImpl(bool bNativeCall, FGMPKey RequestSequence,
 	}
 }
 
-FGMPKey FMessageHub::ListenMessageImpl(const FName& MessageKey, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Slot, int32 Times)
+static FGMPMsgSignal* FindOrAddSig(FGMPSignalMap& MessageSignals, const FMSGKEY& MessageKey)
 {
-	if (!MessageSignals.Contains(MessageKey))
-		MessageSignals.Add(MessageKey).Store = FGMPMsgSignal::MakeSignals();
+	const int32 Index = MessageKey.GetMessageIndex() != INDEX_NONE ? MessageKey.GetMessageIndex() : FMessageKeyIndex::Intern(MessageKey);
+	auto& Sig = MessageSignals.FindOrAdd(Index);
+	if (!Sig.Store.IsValid())
+		Sig.Store = FGMPMsgSignal::MakeSignals();
+	return static_cast<FGMPMsgSignal*>(&Sig);
+}
 
-	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
+namespace Hub
+{
+	static UWorld* GetShardWorld(const UObject* Obj)
+	{
+		UWorld* World = Obj ? Obj->GetWorld() : nullptr;
+		return (IsValid(World) && World->IsGameWorld() && !World->bIsTearingDown) ? World : nullptr;
+	}
+}  // namespace Hub
+
+void FMessageHub::EnableWorldShards()
+{
+#if GMP_WORLD_SHARDED_HUB
+	bWorldShards = true;
+#endif
+}
+
+FMessageHub::FWorldShard* FMessageHub::FindOrAddShard(FSigSource InSigSrc, const UObject* Listener)
+{
+	if (!bWorldShards)
+		return nullptr;
+
+	UWorld* World = Hub::GetShardWorld(InSigSrc.TryGetUObject());
+	if (!World)
+		World = Hub::GetShardWorld(Listener);
+	if (!World)
+		return nullptr;
+
+	if (TrueOnFirstCall([] {}))
+	{
+		// listeners still hear the cleanup messages of their world, the shard goes at the end of that frame
+		FWorldDelegates::OnPostWorldCleanup.AddLambda([](UWorld* InWorld, auto&&...) {
+			for (auto Hub : MessageHubs)
+			{
+				for (auto& Shard : Hub->WorldShards)
+				{
+					if (Shard->World == InWorld)
+						Shard->bReleased = true;
+				}
+			}
+		});
+		FCoreDelegates::OnEndFrame.AddLambda([] {
+			for (auto Hub : MessageHubs)
+				Hub->WorldShards.RemoveAllSwap([](const TUniquePtr<FWorldShard>& Shard) { return Shard->bReleased; });
+		});
+	}
+
+	for (auto& Shard : WorldShards)
+	{
+		if (Shard->IsFor(World))
+		{
+			Shard->bReleased = false;
+			return Shard.Get();
+		}
+	}
+	return WorldShards.Add_GetRef(MakeUnique<FWorldShard>(World)).Get();
+}
+
+FGMPSignalMap& FMessageHub::GetListenSignals(const FMSGKEY& MessageKey, FSigSource InSigSrc, const UObject* Listener, FWorldShard*& OutShard)
+{
+	OutShard = CallbackMarks.Contains(MessageKey) ? nullptr : FindOrAddShard(InSigSrc, Listener);
+	return OutShard ? OutShard->MessageSignals : MessageSignals;
+}
+
+template<typename K, typename F>
+void FMessageHub::ForEachWorldSignal(const K& MessageKey, const UObject* WorldContextObj, const F& Func) const
+{
+	ForEachWorldShard(WorldContextObj, [&](FWorldShard* Shard) {
+		if (auto Ptr = FindSig<FGMPMsgSignal>(Shard->MessageSignals, MessageKey))
+			Func(Ptr);
+	});
+}
+
+bool FMessageHub::FindWorldListeners(const FMSGKEYFind& MessageKey, FSigSource InSigSrc) const
+{
+	bool bFound = false;
+	ForEachWorldSignal(MessageKey, InSigSrc.TryGetUObject(), [&](FGMPMsgSignal*) { bFound = true; });
+	return bFound;
+}
+
+FGMPKey FMessageHub::ListenMessageImpl(const FMSGKEY& MessageKey, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Slot, int32 Times)
+{
+	FWorldShard* Shard = nullptr;
+	if (auto Ptr = FindOrAddSig(GetListenSignals(MessageKey, InSigSrc, Listener.GetObj(), Shard), MessageKey))
 	{
 		if (auto Elem = Ptr->Connect(Listener.GetObj(), std::move(Slot), InSigSrc))
 		{
@@ -311,31 +688,49 @@ FGMPKey FMessageHub::ListenMessageImpl(const FName& MessageKey, FSigSource InSig
 				Ptr->BindSignalConnection(Inc->GMPSignalHandle, Elem->GetGMPKey());
 			}
 
-			return Elem->GetGMPKey();
+			const FGMPKey Key = Elem->GetGMPKey();
+			if (IsRetainedKey(MessageKey))
+				ReplayRetained(Ptr, Shard, MessageKey, InSigSrc, Listener.GetObj(), Key);
+			return Key;
 		}
 	}
 	return {};
 }
 
-FGMPKey FMessageHub::ListenMessageImpl(const FName& MessageKey, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Slot, int32 Times)
+FGMPKey FMessageHub::ListenMessageImpl(const FMSGKEY& MessageKey, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Slot, int32 Times)
 {
-	if (!MessageSignals.Contains(MessageKey))
-		MessageSignals.Add(MessageKey).Store = FGMPMsgSignal::MakeSignals();
-
-	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
+	FWorldShard* Shard = nullptr;
+	if (auto Ptr = FindOrAddSig(GetListenSignals(MessageKey, InSigSrc, nullptr, Shard), MessageKey))
 	{
 		if (auto Elem = Ptr->Connect(Listener, std::move(Slot), InSigSrc))
 		{
 			GMP_LOG(TEXT("FMessageHub::ListenMessage Key[%s] Handle[%p] Watched[%s]"), *MessageKey.ToString(), Listener, *InSigSrc.GetNameSafe());
 
 			Elem->SetLeftTimes(Times);
-			return Elem->GetGMPKey();
+			const FGMPKey Key = Elem->GetGMPKey();
+			if (IsRetainedKey(MessageKey))
+				ReplayRetained(Ptr, Shard, MessageKey, InSigSrc, nullptr, Key);
+			return Key;
 		}
 	}
 	return {};
 }
 
-void FMessageHub::UnListenMessageImpl(const FName& MessageKey, FGMPKey InKey)
+void FMessageHub::SetListenPriority(const FMSGKEYFind& MessageKey, FGMPKey InKey, int32 Priority)
+{
+	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
+		Ptr->SetPriority(InKey, Priority);
+	ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { WorldPtr->SetPriority(InKey, Priority); });
+}
+
+void FMessageHub::ReleaseIfEmpty(const FMSGKEYFind& MessageKey, FSignalBase* Ptr)
+{
+	// signals of this hub may be referenced up the stack while it sends
+	if (MessageBodyStack.Num() == 0 && static_cast<FGMPMsgSignal*>(Ptr)->Num() == 0)
+		MessageSignals.Remove(MessageKey.ResolveMessageIndex());
+}
+
+void FMessageHub::UnListenMessageImpl(const FMSGKEYFind& MessageKey, FGMPKey InKey)
 {
 	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
 	{
@@ -345,10 +740,13 @@ void FMessageHub::UnListenMessageImpl(const FName& MessageKey, FGMPKey InKey)
 			GMP_LOG(TEXT("FMessageHub::UnListenMessageImpl Key[%s] UnListen ID[%s]"), *MessageKey.ToString(), *InKey.ToString());
 			Ptr->Disconnect(InKey);
 		}
+		ReleaseIfEmpty(MessageKey, Ptr);
 	}
+	if (InKey)
+		ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { WorldPtr->Disconnect(InKey); });
 }
 
-void FMessageHub::UnListenMessageImpl(const FName& MessageKey, const UObject* Listener)
+void FMessageHub::UnListenMessageImpl(const FMSGKEYFind& MessageKey, const UObject* Listener)
 {
 	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
 	{
@@ -358,10 +756,13 @@ void FMessageHub::UnListenMessageImpl(const FName& MessageKey, const UObject* Li
 			GMP_LOG(TEXT("FMessageHub::UnListenMessageImpl Key[%s] UnListen Obj[%s]"), *MessageKey.ToString(), *GetNameSafe(Listener));
 			Ptr->Disconnect(Listener);
 		}
+		ReleaseIfEmpty(MessageKey, Ptr);
 	}
+	if (Listener)
+		ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { WorldPtr->Disconnect(Listener); });
 }
 
-void FMessageHub::UnListenMessageImpl(const FName& MessageKey, const UObject* Listener, FSigSource InSigSrc)
+void FMessageHub::UnListenMessageImpl(const FMSGKEYFind& MessageKey, const UObject* Listener, FSigSource InSigSrc)
 {
 	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
 	{
@@ -371,47 +772,621 @@ void FMessageHub::UnListenMessageImpl(const FName& MessageKey, const UObject* Li
 			GMP_LOG(TEXT("FMessageHub::UnListenMessageImpl Key[%s] UnListen Obj[%s] Src[%p]"), *MessageKey.ToString(), *GetNameSafe(Listener), InSigSrc.GetAddrValue());
 			Ptr->Disconnect(Listener, InSigSrc);
 		}
+		ReleaseIfEmpty(MessageKey, Ptr);
 	}
+	if (Listener)
+		ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { WorldPtr->Disconnect(Listener, InSigSrc); });
 }
 
-FGMPKey FMessageHub::NotifyMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Params)
+FGMPKey FMessageHub::NotifyMessageImpl(FSignalBase* Ptr, const FName& MessageKey, FSigSource InSigSrc, FTypedAddresses& Params, FMessageBody::FPayloadMaker PayloadMaker)
 {
 	FMessageBody Msg(Params, MessageKey, InSigSrc);
+	Msg.PayloadMaker = PayloadMaker;
 	auto Seq = Msg.SequenceId;
 	{
 		PushMsgBody(&Msg);
 		ON_SCOPE_EXIT { PopMsgBody(); };
-		auto SignalPtr = static_cast<FGMPMsgSignal*>(Ptr);
 #if WITH_EDITOR
+		TOptional<Hub::FRecursionDetection> Detector;
 		if (GIsEditor)
+			Detector.Emplace(MessageKey, InSigSrc);
+#endif
+
+		// listeners of the source world and the shared ones are merged by priority, the world ones win ties
+		TArray<const FSignalImpl*, TInlineAllocator<4>> Signals;
+		ForEachWorldSignal(MessageKey, InSigSrc.TryGetUObject(), [&](FGMPMsgSignal* WorldPtr) { Signals.Add(WorldPtr); });
+		if (Ptr)
+			Signals.Add(static_cast<FGMPMsgSignal*>(Ptr));
+		if (Signals.Num() > 0)
+			FireSignal(Signals, MessageKey, InSigSrc, Msg);
+
+		if (!Msg.bConsumed && (PrefixListeners.ActivePrefixes.Num() > 0 || (HasWorldShards() && HasWorldPrefixes())))
 		{
-			Hub::FRecursionDetection Detector(MessageKey, InSigSrc);
+			const int32 MessageIndex = ToPrefixedIndex(MessageKey);
+			ForEachWorldShard(InSigSrc.TryGetUObject(), [&](FWorldShard* Shard) {
+				if (!Msg.bConsumed)
+					Shard->PrefixListeners.Fire(MessageIndex, InSigSrc, Msg);
+			});
+			if (!Msg.bConsumed)
+				PrefixListeners.Fire(MessageIndex, InSigSrc, Msg);
+		}
+	}
+
+	if (IsRetainedKey(MessageKey))
+		RetainPayload(Msg);
+	return Seq;
+}
+
+void FMessageHub::FireSignal(TArrayView<const FSignalImpl* const> Signals, const FName& MessageKey, FSigSource InSigSrc, FMessageBody& Msg)
+{
+	auto SignalPtr = static_cast<const FGMPMsgSignal*>(Signals[0]);
+	auto Merged = Signals.Slice(1, Signals.Num() - 1);
+#if WITH_EDITOR
+	if (GIsEditor)
+	{
+		auto IDs = SignalPtr->FireMergedUntil(Merged, InSigSrc, Msg.bConsumed, Msg);
+		Hub::GetHistoryCalls().FindOrAdd(MessageKey).AppendCallInfo(InSigSrc, Msg, MoveTemp(IDs));
+		return;
+	}
+#endif
+	SignalPtr->FireMergedUntil(Merged, InSigSrc, Msg.bConsumed, Msg);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void FMessageHub::SetMessageRetained(const FName& MessageKey, bool bRetain, bool bPerSource)
+{
+	if (!bRetain)
+	{
+		RetainedKeys.Remove(MessageKey);
+		ClearRetained(MessageKey);
+		return;
+	}
+
+	auto Find = RetainedKeys.Find(MessageKey);
+	if (Find && *Find != bPerSource)
+		ClearRetained(MessageKey);
+	RetainedKeys.Add(MessageKey, bPerSource);
+}
 
-			auto IDs = SignalPtr->FireWithSigSource(InSigSrc, Msg);
-			Hub::GetHistoryCalls().FindOrAdd(MessageKey).AppendCallInfo(InSigSrc, Msg, MoveTemp(IDs));
+const FMessageHub::FRetainedValue* FMessageHub::FRetainedStore::Find(const FName& MessageKey, FSigSource SigSrc) const
+{
+	auto KeyValues = Values.Find(MessageKey);
+	return KeyValues ? KeyValues->Find(SigSrc) : nullptr;
+}
+
+FMessageHub::FRetainedValue& FMessageHub::FRetainedStore::Add(const FName& MessageKey, FSigSource SigSrc, FMessagePayloadPtr Payload)
+{
+	Remove(MessageKey, SigSrc);
+
+	FRetainedValue& Value = Values.FindOrAdd(MessageKey).Add(SigSrc);
+	Value.Payload = MoveTemp(Payload);
+	Value.Serial = ++Hub::RetainedSerial;
+	Value.Size = Value.Payload->PayloadSize + sizeof(FRetainedValue);
+	Bytes += Value.Size;
+	++Num;
+	Order.Add(FOrder{MessageKey, SigSrc, Value.Serial});
+	return Value;
+}
+
+void FMessageHub::FRetainedStore::Remove(const FName& MessageKey, FSigSource SigSrc)
+{
+	auto KeyValues = Values.Find(MessageKey);
+	FRetainedValue Value;
+	if (KeyValues && KeyValues->RemoveAndCopyValue(SigSrc, Value))
+	{
+		Bytes -= Value.Size;
+		--Num;
+		if (KeyValues->Num() == 0)
+			Values.Remove(MessageKey);
+	}
+}
+
+void FMessageHub::FRetainedStore::Remove(const FName& MessageKey)
+{
+	TMap<FSigSource, FRetainedValue> KeyValues;
+	if (Values.RemoveAndCopyValue(MessageKey, KeyValues))
+	{
+		for (auto& Pair : KeyValues)
+			Bytes -= Pair.Value.Size;
+		Num -= KeyValues.Num();
+	}
+}
+
+void FMessageHub::FRetainedStore::Evict(int32 MaxNum, int64 MaxBytes)
+{
+	// the newest payload is last in the queue and is never the one evicted
+	while (Num > 1 && (Num > MaxNum || Bytes > MaxBytes))
+	{
+		const FOrder& Oldest = Order[OrderHead++];
+		auto Value = Find(Oldest.MessageKey, Oldest.SigSrc);
+		if (Value && Value->Serial == Oldest.Serial)
+			Remove(Oldest.MessageKey, Oldest.SigSrc);
+	}
+
+	// drop the popped and replaced entries once they outnumber the live ones
+	if (Order.Num() > 2 * Num + 64)
+	{
+		TArray<FOrder> Live;
+		Live.Reserve(Num);
+		for (int32 Idx = OrderHead; Idx < Order.Num(); ++Idx)
+		{
+			auto Value = Find(Order[Idx].MessageKey, Order[Idx].SigSrc);
+			if (Value && Value->Serial == Order[Idx].Serial)
+				Live.Add(Order[Idx]);
 		}
-		else
+		Order = MoveTemp(Live);
+		OrderHead = 0;
+	}
+}
+
+void FMessageHub::FRetainedStore::Empty()
+{
+	Values.Empty();
+	Order.Empty();
+	OrderHead = 0;
+	Num = 0;
+	Bytes = 0;
+}
+
+void FMessageHub::FRetainedStore::Dump(FOutputDevice& Ar) const
+{
+	for (auto& KeyPair : Values)
+	{
+		for (auto& Pair : KeyPair.Value)
+			Ar.Logf(TEXT("  %s Src[%s] %u bytes #%llu"), *KeyPair.Key.ToString(), *Pair.Value.Payload->SigSrc.GetNameSafe(), Pair.Value.Size, Pair.Value.Serial);
+	}
+}
+
+void FMessageHub::ClearRetained(const FName& MessageKey)
+{
+	RetainedValues.Remove(MessageKey);
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { Shard->RetainedValues.Remove(MessageKey); });
+}
+
+void FMessageHub::ClearRetained()
+{
+	RetainedValues.Empty();
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { Shard->RetainedValues.Empty(); });
+}
+
+void FMessageHub::RetainPayload(FMessageBody& Msg)
+{
+	const bool bPerSource = RetainedKeys.FindChecked(Msg.MessageKey());
+	const FSigSource RetainedSrc = bPerSource ? Msg.CurSigSrc : FSigSource::NullSigSrc;
+	// payloads per source of a game world go with that world
+	auto Shard = RetainedSrc ? FindOrAddShard(RetainedSrc) : nullptr;
+	FRetainedStore& Store = Shard ? Shard->RetainedValues : RetainedValues;
+
+	// a payload retained before must not be replayed as the last one
+	auto Payload = Msg.GetSharedPayload();
+	if (!GMP_CNOTE_ONCE(Payload.IsValid(), TEXT("retained message %s has no copyable payload, script sends are not retained"), *Msg.MessageKey().ToString()))
+	{
+		Store.Remove(Msg.MessageKey(), RetainedSrc);
+		return;
+	}
+
+	FRetainedValue& Value = Store.Add(Msg.MessageKey(), RetainedSrc, MoveTemp(Payload));
+	Value.WeakSrc = const_cast<UObject*>(Msg.CurSigSrc.TryGetUObject());
+	Store.Evict(Hub::RetainedMaxEntries, int64(Hub::RetainedMaxKB) * 1024);
+}
+
+void FMessageHub::ReplayRetained(FSignalBase* Ptr, FWorldShard* Shard, const FName& MessageKey, FSigSource InSigSrc, const UObject* Listener, FGMPKey Key)
+{
+	// a listener within a world gets the payloads of that world, others those of every world
+	TArray<FRetainedStore*, TInlineAllocator<4>> Stores{&RetainedValues};
+	if (Shard)
+		Stores.Add(&Shard->RetainedValues);
+	else
+		ForEachWorldShard(nullptr, [&](FWorldShard* Elm) { Stores.Add(&Elm->RetainedValues); });
+
+	// a listener without source gets the payloads of all sources, one watching a world gets those sent within it
+	const UWorld* WatchedWorld = Cast<UWorld>(InSigSrc.TryGetUObject());
+	TArray<TPair<FRetainedStore*, FSigSource>, TInlineAllocator<4>> Stales;
+	TArray<const FRetainedValue*, TInlineAllocator<4>> Values;
+	for (auto Store : Stores)
+	{
+		auto KeyValues = Store->Values.Find(MessageKey);
+		if (!KeyValues)
+			continue;
+
+		for (auto& Pair : *KeyValues)
+		{
+			auto& Value = Pair.Value;
+			// the copied object arguments are not kept alive, a payload with any of them collected is dropped
+			const UObject* SrcObj = Value.Payload->SigSrc.TryGetUObject();
+			if ((SrcObj && !Value.WeakSrc.IsValid()) || Value.Payload->HasStaleObjects())
+			{
+				Stales.Emplace(Store, Pair.Key);
+				continue;
+			}
+
+			if (InSigSrc && !(Value.Payload->SigSrc == InSigSrc) && !(WatchedWorld && SrcObj && SrcObj->GetWorld() == WatchedWorld))
+				continue;
+#if WITH_EDITOR
+			// if mutli world in one process : PIE
+			if (Listener && SrcObj && Listener->GetWorld() != SrcObj->GetWorld())
+				continue;
 #endif
+			Values.Add(&Value);
+		}
+	}
+	if (!Values.Num() && !Stales.Num())
+		return;
+
+	// listeners may send the key again while replaying, hold the payloads
+	Values.Sort([](const FRetainedValue& Lhs, const FRetainedValue& Rhs) { return Lhs.Serial < Rhs.Serial; });
+	TArray<FMessagePayloadPtr, TInlineAllocator<4>> Payloads;
+	for (auto Value : Values)
+		Payloads.Add(Value->Payload);
+	for (auto& Stale : Stales)
+		Stale.Key->Remove(MessageKey, Stale.Value);
+
+	auto SignalPtr = static_cast<FGMPMsgSignal*>(Ptr);
+	for (auto& Payload : Payloads)
+	{
+		GMP_LOG(TEXT("FMessageHub::ReplayRetained Key[%s] Listener[%s] Src[%s]"), *MessageKey.ToString(), *GetNameSafe(Listener), *Payload->SigSrc.GetNameSafe());
+		// inline listeners may write to their arguments, the retained value stays as it was sent
+		auto Copy = Payload->Clone();
+		FMessageBody Body(*Copy);
+		Body.SharedPayload = Payload;
+		PushMsgBody(&Body);
+		ON_SCOPE_EXIT { PopMsgBody(); };
+		if (!SignalPtr->FireSlot(Key, Body) || !SignalPtr->IsAlive(Key))
+			break;
+	}
+}
+
+void FMessageHub::DumpRetained(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("FMessageHub[%p] %d retained keys, %d payloads, %lld bytes"), this, RetainedKeys.Num(), RetainedValues.Num, RetainedValues.Bytes);
+	RetainedValues.Dump(Ar);
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) {
+		Ar.Logf(TEXT(" World[%s] %d payloads, %lld bytes"), *GetNameSafe(Shard->WeakWorld.Get()), Shard->RetainedValues.Num, Shard->RetainedValues.Bytes);
+		Shard->RetainedValues.Dump(Ar);
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+namespace Hub
+{
+	static int32 CoalescedTickGroup = TG_PostUpdateWork;
+	FAutoConsoleVariableRef CVar_CoalescedTickGroup(TEXT("GMP.CoalescedTickGroup"), CoalescedTickGroup, TEXT("tick group at which deferred messages are sent, 0 pre physics .. 5 post update work, read when a world initializes"));
+
+	// flushes the deferred messages of all hubs, the first world to tick this frame does it
+	struct FCoalescedTickFunction : public FTickFunction
+	{
+		virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override { FMessageHub::FlushDeferredMessages(); }
+		virtual FString DiagnosticMessage() override { return TEXT("GMP.CoalescedTickFunction"); }
+	};
+	static TMap<TObjectKey<UWorld>, TUniquePtr<FCoalescedTickFunction>> CoalescedTicks;
+
+	static void AddCoalescedTick(UWorld* World)
+	{
+		if (!IsValid(World) || !World->IsGameWorld() || !World->PersistentLevel || CoalescedTicks.Contains(World))
+			return;
+
+		auto& TickFunction = CoalescedTicks.Add(World, MakeUnique<FCoalescedTickFunction>());
+		TickFunction->bCanEverTick = true;
+		TickFunction->bTickEvenWhenPaused = true;
+		TickFunction->TickGroup = (ETickingGroup)FMath::Clamp(CoalescedTickGroup, (int32)TG_PrePhysics, (int32)TG_PostUpdateWork);
+		TickFunction->RegisterTickFunction(World->PersistentLevel);
+	}
+
+	static void InitCoalescedTicks()
+	{
+		if (!TrueOnFirstCall([] {}))
+			return;
+
+		FWorldDelegates::OnPostWorldInitialization.AddLambda([](UWorld* World, auto&&...) { AddCoalescedTick(World); });
+		FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, auto&&...) { CoalescedTicks.Remove(World); });
+		// worlds that do not tick still get their messages once per frame
+		FCoreDelegates::OnEndFrame.AddLambda([] { FMessageHub::FlushDeferredMessages(); });
+		if (GEngine)
 		{
-			SignalPtr->FireWithSigSource(InSigSrc, Msg);
+			for (const FWorldContext& Context : GEngine->GetWorldContexts())
+				AddCoalescedTick(Context.World());
 		}
 	}
-	return Seq;
+}  // namespace Hub
+
+// messages deferred by a source in a game world go with that world
+FMessageHub::FCoalescedQueue& FMessageHub::GetCoalescedQueue(FSigSource InSigSrc)
+{
+	auto Shard = FindOrAddShard(InSigSrc);
+	return Shard ? Shard->CoalescedQueue : CoalescedQueue;
+}
+
+Hub::FCoalescedMessage* FMessageHub::FindCoalesced(const FMSGKEY& MessageKey, FSigSource InSigSrc)
+{
+	auto& Queue = GetCoalescedQueue(InSigSrc);
+	if (!Queue.Slots.Num())
+		return nullptr;
+	return Queue.Slots.FindRef(TPair<int32, FSigSource>(MessageKey.ResolveMessageIndex(), InSigSrc));
+}
+
+Hub::FCoalescedMessage* FMessageHub::AddCoalesced(TUniquePtr<Hub::FCoalescedMessage> Message)
+{
+	Hub::InitCoalescedTicks();
+	const FMSGKEY& MessageKey = Message->MessageKey;
+	const int32 Index = MessageKey.GetMessageIndex() != INDEX_NONE ? MessageKey.GetMessageIndex() : FMessageKeyIndex::Intern(MessageKey);
+	auto Ptr = Message.Get();
+	auto& Queue = GetCoalescedQueue(Message->SigSrc);
+	Queue.Slots.Add(TPair<int32, FSigSource>(Index, Message->SigSrc), Ptr);
+	Queue.Messages.Add(MoveTemp(Message));
+	return Ptr;
+}
+
+void FMessageHub::SendCoalesced(Hub::FCoalescedMessage* Message)
+{
+	auto& Queue = GetCoalescedQueue(Message->SigSrc);
+	const int32 Idx = Queue.Messages.IndexOfByPredicate([&](const TUniquePtr<Hub::FCoalescedMessage>& Elm) { return Elm.Get() == Message; });
+	if (!ensure(Idx != INDEX_NONE))
+		return;
+
+	TUniquePtr<Hub::FCoalescedMessage> Sending = MoveTemp(Queue.Messages[Idx]);
+	Queue.Slots.Remove(TPair<int32, FSigSource>(Sending->MessageKey.ResolveMessageIndex(), Sending->SigSrc));
+	Sending->Dispatch(this);
+}
+
+int32 FMessageHub::FlushCoalesced()
+{
+	int32 Count = FlushCoalesced(CoalescedQueue);
+	// the messages of a cleaned up world go with its shard, listeners may add shards while flushing
+	for (int32 Idx = 0; Idx < WorldShards.Num(); ++Idx)
+	{
+		if (!WorldShards[Idx]->bReleased)
+			Count += FlushCoalesced(WorldShards[Idx]->CoalescedQueue);
+	}
+	return Count;
+}
+
+int32 FMessageHub::FlushCoalesced(FCoalescedQueue& Queue)
+{
+	if (!Queue.Messages.Num())
+		return 0;
+
+	// messages deferred by listeners wait for the next flush
+	auto Messages = MoveTemp(Queue.Messages);
+	Queue.Slots.Reset();
+	int32 Count = 0;
+	for (auto& Message : Messages)
+	{
+		if (!Message)
+			continue;
+		GMP_DEBUG_LOG(TEXT("FMessageHub::FlushCoalesced Key[%s] Src[%s] folded %d sends"), *Message->MessageKey.ToString(), *Message->SigSrc.GetNameSafe(), Message->SendNum);
+		Message->Dispatch(this);
+		++Count;
+	}
+	return Count;
+}
+
+int32 FMessageHub::FlushDeferredMessages()
+{
+	checkSlow(IsInGameThread());
+	int32 Count = 0;
+	for (auto Hub : MessageHubs.Array())
+	{
+		if (Hub->IsValidHub())
+			Count += Hub->FlushCoalesced();
+	}
+	return Count;
+}
+
+//////////////////////////////////////////////////////////////////////////
+FGMPKey FMessageHub::ListenPrefixImpl(const FName& Prefix, FSigSource InSigSrc, FSigListener Listener, FGMPMessageSig&& Slot, int32 Times)
+{
+	auto Shard = FindOrAddShard(InSigSrc, Listener.GetObj());
+	auto& Listeners = Shard ? Shard->PrefixListeners : PrefixListeners;
+	const int32 PrefixIndex = FMessageKeyIndex::Intern(Prefix);
+	auto Ptr = static_cast<FGMPMsgSignal*>(&Listeners.Signals.FindOrAdd(PrefixIndex));
+	if (!Ptr->Store.IsValid())
+		Ptr->Store = FGMPMsgSignal::MakeSignals();
+
+	if (auto Elem = Ptr->Connect(Listener.GetObj(), std::move(Slot), InSigSrc))
+	{
+		GMP_LOG(TEXT("FMessageHub::ListenMessagePrefix Prefix[%s] Listener[%s] Watched[%s]"), *Prefix.ToString(), *GetNameSafe(Listener.GetObj()), *InSigSrc.GetNameSafe());
+		Elem->SetLeftTimes(Times);
+		if (auto Inc = Listener.GetInc())
+			Ptr->BindSignalConnection(Inc->GMPSignalHandle, Elem->GetGMPKey());
+		Listeners.AddActive(PrefixIndex);
+		return Elem->GetGMPKey();
+	}
+	return {};
+}
+
+FGMPKey FMessageHub::ListenPrefixImpl(const FName& Prefix, FSigSource InSigSrc, FSigCollection* Listener, FGMPMessageSig&& Slot, int32 Times)
+{
+	auto Shard = FindOrAddShard(InSigSrc);
+	auto& Listeners = Shard ? Shard->PrefixListeners : PrefixListeners;
+	const int32 PrefixIndex = FMessageKeyIndex::Intern(Prefix);
+	auto Ptr = static_cast<FGMPMsgSignal*>(&Listeners.Signals.FindOrAdd(PrefixIndex));
+	if (!Ptr->Store.IsValid())
+		Ptr->Store = FGMPMsgSignal::MakeSignals();
+
+	if (auto Elem = Ptr->Connect(Listener, std::move(Slot), InSigSrc))
+	{
+		GMP_LOG(TEXT("FMessageHub::ListenMessagePrefix Prefix[%s] Handle[%p] Watched[%s]"), *Prefix.ToString(), Listener, *InSigSrc.GetNameSafe());
+		Elem->SetLeftTimes(Times);
+		Listeners.AddActive(PrefixIndex);
+		return Elem->GetGMPKey();
+	}
+	return {};
+}
+
+namespace Hub
+{
+	template<typename T, typename F>
+	void UnListenPrefix(T& Listeners, int32 PrefixIndex, const F& Disconnect)
+	{
+		if (auto Ptr = static_cast<FGMPMsgSignal*>(Listeners.Signals.Find(PrefixIndex)))
+		{
+			Disconnect(Ptr);
+			if (Ptr->Num() == 0)
+				Listeners.RemoveActive(PrefixIndex);
+		}
+	}
+}  // namespace Hub
+
+void FMessageHub::UnListenMessagePrefix(const FName& Prefix, FGMPKey InKey)
+{
+	const int32 PrefixIndex = FMessageKeyIndex::Find(Prefix);
+	auto Disconnect = [&](FGMPMsgSignal* Ptr) { Ptr->Disconnect(InKey); };
+	Hub::UnListenPrefix(PrefixListeners, PrefixIndex, Disconnect);
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { Hub::UnListenPrefix(Shard->PrefixListeners, PrefixIndex, Disconnect); });
+}
+
+void FMessageHub::UnListenMessagePrefix(const FName& Prefix, const UObject* Listener)
+{
+	const int32 PrefixIndex = FMessageKeyIndex::Find(Prefix);
+	auto Disconnect = [&](FGMPMsgSignal* Ptr) { Ptr->Disconnect(Listener); };
+	Hub::UnListenPrefix(PrefixListeners, PrefixIndex, Disconnect);
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { Hub::UnListenPrefix(Shard->PrefixListeners, PrefixIndex, Disconnect); });
+}
+
+namespace Hub
+{
+	template<typename F>
+	void ForEachKeyUnder(int32 PrefixIndex, const F& Func)
+	{
+		TArray<int32, TInlineAllocator<16>> Pending{PrefixIndex};
+		while (Pending.Num() > 0)
+		{
+			const int32 Index = Pending.Pop(false);
+			Func(Index);
+			FMessageKeyIndex::GetChildren(Index, Pending);
+		}
+	}
+}  // namespace Hub
+
+const FMessageHub::FPrefixFanout* FMessageHub::FPrefixListeners::FindFanout(int32 MessageIndex)
+{
+	if (MessageIndex == INDEX_NONE)
+		return nullptr;
+	if (MessageIndex >= Fanouts.Num())
+		Fanouts.SetNum(FMath::Max(MessageIndex + 1, FMessageKeyIndex::Num()));
+
+	auto& Fanout = Fanouts[MessageIndex];
+	if (!Fanout.bBuilt)
+	{
+		// walk up the key hierarchy, outermost prefix first
+		Fanout.bBuilt = true;
+		Fanout.Prefixes.Reset();
+		for (int32 Index = MessageIndex; Index != INDEX_NONE; Index = FMessageKeyIndex::GetParent(Index))
+		{
+			if (ActivePrefixes.Contains(Index))
+				Fanout.Prefixes.Insert(Index, 0);
+		}
+	}
+
+	// prefix listeners also end through gc, Times or their collection without UnListenMessagePrefix
+	for (int32 Idx = Fanout.Prefixes.Num() - 1; Idx >= 0; --Idx)
+	{
+		const int32 PrefixIndex = Fanout.Prefixes[Idx];
+		auto PrefixPtr = static_cast<const FGMPMsgSignal*>(Signals.Find(PrefixIndex));
+		if (!PrefixPtr || PrefixPtr->Num() == 0)
+			RemoveActive(PrefixIndex);
+	}
+	return Fanout.Prefixes.Num() > 0 ? &Fanout : nullptr;
+}
+
+bool FMessageHub::FPrefixListeners::IsAlive(int32 MessageIndex) const
+{
+	for (int32 Index = MessageIndex; Index != INDEX_NONE; Index = FMessageKeyIndex::GetParent(Index))
+	{
+		auto PrefixPtr = static_cast<const FGMPMsgSignal*>(Signals.Find(Index));
+		if (PrefixPtr && PrefixPtr->Num() > 0)
+			return true;
+	}
+	return false;
+}
+
+void FMessageHub::FPrefixListeners::AddActive(int32 PrefixIndex)
+{
+	if (ActivePrefixes.Contains(PrefixIndex))
+		return;
+
+	// only keys already under the prefix need their fan-out rebuilt
+	ActivePrefixes.Add(PrefixIndex);
+	Hub::ForEachKeyUnder(PrefixIndex, [&](int32 Index) {
+		if (Fanouts.IsValidIndex(Index))
+			Fanouts[Index].bBuilt = false;
+	});
+}
+
+void FMessageHub::FPrefixListeners::RemoveActive(int32 PrefixIndex)
+{
+	if (!ActivePrefixes.RemoveSingleSwap(PrefixIndex))
+		return;
+
+	Hub::ForEachKeyUnder(PrefixIndex, [&](int32 Index) {
+		if (Fanouts.IsValidIndex(Index))
+			Fanouts[Index].Prefixes.RemoveSingle(PrefixIndex);
+	});
+}
+
+void FMessageHub::FPrefixListeners::Fire(int32 MessageIndex, FSigSource InSigSrc, FMessageBody& Msg)
+{
+	auto Fanout = ActivePrefixes.Num() > 0 ? FindFanout(MessageIndex) : nullptr;
+	if (!Fanout)
+		return;
+
+	// listeners may subscribe or leave while firing
+	auto Prefixes = Fanout->Prefixes;
+	for (int32 PrefixIndex : Prefixes)
+	{
+		if (auto PrefixPtr = static_cast<FGMPMsgSignal*>(Signals.Find(PrefixIndex)))
+			PrefixPtr->FireWithSigSourceUntil(InSigSrc, Msg.bConsumed, Msg);
+		if (Msg.bConsumed)
+			break;
+	}
+}
+
+bool FMessageHub::HasWorldPrefixes() const
+{
+	for (auto& Shard : WorldShards)
+	{
+		if (Shard->PrefixListeners.ActivePrefixes.Num() > 0)
+			return true;
+	}
+	return false;
+}
+
+bool FMessageHub::HasWorldPrefixListeners(int32 MessageIndex)
+{
+	bool bFound = false;
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { bFound = bFound || Shard->PrefixListeners.HasListeners(MessageIndex); });
+	return bFound;
 }
 
 bool FMessageHub::IsAlive(const FName& MessageKey, FGMPKey Key) const
 {
 	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
 	{
-		return Key ? Ptr->IsAlive(Key) : true;
+		if (!Key || Ptr->IsAlive(Key))
+			return true;
 	}
-	return false;
+	bool bAlive = false;
+	ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { bAlive = bAlive || !Key || WorldPtr->IsAlive(Key); });
+	if (bAlive || Key)
+		return bAlive;
+
+	auto IsPrefixAlive = [&](const FPrefixListeners& Listeners) { return Listeners.ActivePrefixes.Num() > 0 && Listeners.IsAlive(ToPrefixedIndex(MessageKey)); };
+	bAlive = IsPrefixAlive(PrefixListeners);
+	ForEachWorldShard(nullptr, [&](FWorldShard* Shard) { bAlive = bAlive || IsPrefixAlive(Shard->PrefixListeners); });
+	return bAlive;
 }
 
 FGMPKey FMessageHub::IsAlive(const FName& MessageKey, const UObject* Listener, FSigSource InSigSrc) const
 {
-	const FGMPMsgSignal* Ptr = IsValid(Listener) ? FindSig<FGMPMsgSignal>(MessageSignals, MessageKey) : nullptr;
-	return Ptr ? Ptr->IsAlive(Listener, InSigSrc) : 0u;
+	if (!IsValid(Listener))
+		return 0u;
+	const FGMPMsgSignal* Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey);
+	FGMPKey Ret = Ptr ? Ptr->IsAlive(Listener, InSigSrc) : 0u;
+	ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) {
+		if (!Ret)
+			Ret = WorldPtr->IsAlive(Listener, InSigSrc);
+	});
+	return Ret;
 }
 
 #if WITH_EDITOR
@@ -460,54 +1435,56 @@ namespace Hub
 
 bool FMessageHub::GetListeners(FSigSource InSigSrc, FName MessageKey, TArray<FWeakObjectPtr>& OutArray, int32 MaxCnt)
 {
+	bool bRet = false;
+	ForEachWorldSignal(MessageKey, InSigSrc.TryGetUObject(), [&](FGMPMsgSignal* WorldPtr) { bRet |= Hub::GetListeners(WorldPtr->Store.Get(), InSigSrc, OutArray, MaxCnt); });
 	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
 	{
-		return Hub::GetListeners(Ptr->Store.Get(), InSigSrc, OutArray, MaxCnt);
+		bRet |= Hub::GetListeners(Ptr->Store.Get(), InSigSrc, OutArray, MaxCnt);
 	}
-	return false;
+	return bRet;
 }
 
 bool FMessageHub::GetCallInfos(const UObject* Listener, FName MessageKey, TArray<FString>& OutArray, int32 MaxCnt)
 {
-	if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
+	if (auto ArrFind = Hub::GetHistoryCalls().Find(MessageKey))
 	{
-		if (auto ArrFind = Hub::GetHistoryCalls().Find(MessageKey))
+		TSet<FGMPKey> OutKeys;
+		if (auto Ptr = FindSig<FGMPMsgSignal>(MessageSignals, MessageKey))
+			Hub::GetHandlers(Ptr->Store.Get(), Listener, OutKeys, MaxCnt);
+		ForEachWorldSignal(MessageKey, nullptr, [&](FGMPMsgSignal* WorldPtr) { Hub::GetHandlers(WorldPtr->Store.Get(), Listener, OutKeys, MaxCnt); });
+		if (OutKeys.Num() > 0)
 		{
-			TSet<FGMPKey> OutKeys;
-			if (Hub::GetHandlers(Ptr->Store.Get(), Listener, OutKeys, MaxCnt))
+			auto& Infos = *ArrFind;
+			auto StartIdx = (MaxCnt > 0 && Infos.Num() > MaxCnt) ? Infos.Num() - MaxCnt : 0;
+			for (auto i = Infos.Num() - 1; i >= StartIdx; --i)
 			{
-				auto& Infos = *ArrFind;
-				auto StartIdx = (MaxCnt > 0 && Infos.Num() > MaxCnt) ? Infos.Num() - MaxCnt : 0;
-				for (auto i = Infos.Num() - 1; i >= StartIdx; --i)
+				auto& Info = Infos[i];
+				if (Info.Records.Num() < OutKeys.Num())
 				{
-					auto& Info = Infos[i];
-					if (Info.Records.Num() < OutKeys.Num())
+					for (auto Rec : Info.Records)
 					{
-						for (auto Rec : Info.Records)
+						if (OutKeys.Contains(Rec))
 						{
-							if (OutKeys.Contains(Rec))
-							{
-								OutArray.Add(FString::Printf(TEXT("%c %s"), !Info.Obj.IsStale() ? TEXT('+') : TEXT('-'), *Info.CallInfo));
-								break;
-							}
+							OutArray.Add(FString::Printf(TEXT("%c %s"), !Info.Obj.IsStale() ? TEXT('+') : TEXT('-'), *Info.CallInfo));
+							break;
 						}
 					}
-					else
+				}
+				else
+				{
+					for (auto Key : OutKeys)
 					{
-						for (auto Key : OutKeys)
+						if (Algo::BinarySearch(Info.Records, Key) != INDEX_NONE)
 						{
-							if (Algo::BinarySearch(Info.Records, Key) != INDEX_NONE)
-							{
-								OutArray.Add(FString::Printf(TEXT("%c %s"), !Info.Obj.IsStale() ? TEXT('+') : TEXT('-'), *Info.CallInfo));
-								break;
-							}
+							OutArray.Add(FString::Printf(TEXT("%c %s"), !Info.Obj.IsStale() ? TEXT('+') : TEXT('-'), *Info.CallInfo));
+							break;
 						}
 					}
 				}
-				if (StartIdx != 0)
-					OutArray.Add(TEXT("..."));
-				return true;
 			}
+			if (StartIdx != 0)
+				OutArray.Add(TEXT("..."));
+			return true;
 		}
 	}
 	return false;
@@ -531,7 +1508,11 @@ namespace Hub
 	static auto RhsNoMore = [](FArrType& l, FArrType& r) { return l.Num() >= r.Num(); };
 
 	static void AssingIfPossible(const FName& l, const FName& r) {}
-	static void AssingIfPossible(FName& l, const FName& r) { l = r; }
+	static void AssingIfPossible(FName& l, const FName& r)
+	{
+		l = r;
+		++SignatureVersion;
+	}
 
 	struct FTagDefinition
 	{
@@ -605,6 +1586,7 @@ namespace Hub
 				if (ParamMore)
 				{
 					PtrRecv = &Recvs.Emplace(MessageId, InTypes);
+					++SignatureVersion;
 				}
 			}
 			else
@@ -629,6 +1611,7 @@ namespace Hub
 				if (ParamLess)
 				{
 					PtrSend = &Sends.Emplace(MessageId, InTypes);
+					++SignatureVersion;
 				}
 			}
 
@@ -672,15 +1655,53 @@ namespace Hub
 	}
 }  // namespace Hub
 
-bool FMessageHub::IsSignatureCompatible(bool bCall, const FName& MessageId, const FArrayTypeNames& TypeNames, const FArrayTypeNames*& OldTypes, bool bNativeCall)
+uint64 FMessageBody::HashTypeNames(const FArrayTypeNames& TypeNames)
+{
+	uint64 Hash = 0xcbf29ce484222325ull ^ TypeNames.Num();
+	for (auto& Name : TypeNames)
+	{
+		const uint64 Key = (static_cast<uint64>(GetTypeHash(Name.GetComparisonIndex())) << 32) | static_cast<uint32>(Name.GetNumber());
+		Hash = (Hash ^ Key) * 0x100000001b3ull;
+		Hash ^= Hash >> 29;
+	}
+	return Hash ? Hash : 1;
+}
+
+bool FMessageHub::IsSignatureCompatible(bool bCall, const FName& MessageId, const FArrayTypeNames& TypeNames, const FArrayTypeNames*& OldTypes, bool bNativeCall, uint64 SignatureHash)
 {
 #if GMP_WITH_DYNAMIC_CALL_CHECK
+	if (!SignatureHash)
+		SignatureHash = FMessageBody::HashTypeNames(TypeNames);
+
+	// registered types live in maps that may rehash, so they are looked up again instead of cached
+	if (auto Verified = Hub::GetVerifiedSignatures().Find(MessageId))
+	{
+		if (Verified->ContainsByPredicate([&](const Hub::FVerifiedSignature& Elm) { return Elm.Hash == SignatureHash && Elm.bCall == bCall; }))
+		{
+			OldTypes = bCall ? Hub::GetSends<false>().Find(MessageId) : Hub::GetRecvs<false>().Find(MessageId);
+#if WITH_EDITOR
+			if (GIsEditor && bNativeCall && OldTypes)
+				OnUpdateMessageTagDelegate.ExecuteIfBound(MessageId.ToString(), OldTypes, bCall ? Hub::GetSends<true>().Find(MessageId) : Hub::GetRecvs<true>().Find(MessageId));
+#endif
+			return true;
+		}
+	}
+
 	Hub::FTagDefinition TagDefinition;
 	TagDefinition.ParameterTypes = &TypeNames;
 
 	Hub::FTagDefinition OutTagDefinition;
 	ON_SCOPE_EXIT { OldTypes = OutTagDefinition.ParameterTypes; };
-	return Hub::DoesSignatureCompatible(bCall, MessageId, TagDefinition, OutTagDefinition, bNativeCall);
+	const uint32 Version = Hub::SignatureVersion;
+	if (!Hub::DoesSignatureCompatible(bCall, MessageId, TagDefinition, OutTagDefinition, bNativeCall))
+		return false;
+
+	// only successful checks are cached, the types of other message ids are untouched by this one
+	auto& Verified = Hub::GetVerifiedSignatures().FindOrAdd(MessageId);
+	if (Version != Hub::SignatureVersion)
+		Verified.Reset();
+	Verified.Add(Hub::FVerifiedSignature{SignatureHash, bCall});
+	return true;
 #else
 	return true;
 #endif
@@ -722,15 +1743,25 @@ bool FMessageBody::IsSignatureCompatible(bool bCall, const FArrayTypeNames*& Old
 
 UGMPManager::UGMPManager()
 {
+	// the default object carries the hub of FMessageUtils
+	if (HasAnyFlags(RF_ClassDefaultObject))
+		MessageHub.EnableWorldShards();
+
+	if (TrueOnFirstCall([] {}))
+	{
+		// retained payloads may point at objects of the previous map
+		FCoreUObjectDelegates::PreLoadMap.AddLambda([](const FString& MapName) {
+			for (auto Hub : GMP::MessageHubs)
+				Hub->ClearRetained();
+		});
+	}
+
 #if GMP_WITH_DYNAMIC_CALL_CHECK
 	if (TrueOnFirstCall([] {}))
 	{
 		// Register for PreloadMap so cleanup can occur on map transitions
 		FCoreUObjectDelegates::PreLoadMap.AddLambda([](const FString& MapName) {
-			GMP::Hub::GetSends<true>().Empty();
-			GMP::Hub::GetRecvs<true>().Empty();
-			GMP::Hub::GetSends<false>().Empty();
-			GMP::Hub::GetRecvs<false>().Empty();
+			GMP::Hub::ResetSignatures();
 			GMP::Hub::GMPResponses().Empty();
 		});
 
@@ -739,10 +1770,7 @@ UGMPManager::UGMPManager()
 		{
 			// Register in editor for PreBeginPlay so cleanup can occur when we start a PIE session
 			FEditorDelegates::PreBeginPIE.AddLambda([](bool bIsSimulating) {
-				GMP::Hub::GetSends<true>().Empty();
-				GMP::Hub::GetRecvs<true>().Empty();
-				GMP::Hub::GetSends<false>().Empty();
-				GMP::Hub::GetRecvs<false>().Empty();
+				GMP::Hub::ResetSignatures();
 				GMP::Hub::GetHistoryCalls().Empty();
 				GMP::Hub::GMPResponses().Empty();
 			});
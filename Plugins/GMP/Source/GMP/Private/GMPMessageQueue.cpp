@@ -0,0 +1,172 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#include "GMPMessageQueue.h"
+
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "GMPTypeTraits.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+
+namespace GMP
+{
+namespace PostedQueue
+{
+	static int32 QueueSizeKB = 256;
+	static FAutoConsoleVariableRef CVar_QueueSize(TEXT("GMP.PostedMessageQueueSize"), QueueSizeKB, TEXT("ring size in KB of messages posted from any thread, read once on first post"), ECVF_Default);
+
+	enum EFlushPoint
+	{
+		WorldTickStart,
+		PostActorTick,
+		EndFrame,
+	};
+	static int32 FlushPoint = EFlushPoint::WorldTickStart;
+	static FAutoConsoleVariableRef CVar_FlushPoint(TEXT("GMP.PostedMessageFlushPoint"), FlushPoint, TEXT("when posted messages are sent on the game thread: 0 world tick start, 1 post actor tick, 2 end of frame"), ECVF_Default);
+
+	enum ERecordState : int32
+	{
+		Writing = 0,
+		Ready = 1,
+		Padding = 2,
+	};
+
+	// records are laid out back to back and never straddle the end of the ring
+	struct alignas(FPostedMessageQueue::RecordAlignment) FRecordHeader
+	{
+		volatile int32 State;
+		uint32 Size;
+		FPostedMessageQueue::FDispatchFunc Dispatch;
+	};
+	static_assert(sizeof(FRecordHeader) <= FPostedMessageQueue::RecordAlignment, "err");
+
+	static void TryDrain(EFlushPoint InPoint)
+	{
+		if (FlushPoint == InPoint)
+			FPostedMessageQueue::Get().Drain();
+	}
+}  // namespace PostedQueue
+
+FPostedMessageQueue& FPostedMessageQueue::Get()
+{
+	static FPostedMessageQueue Queue;
+	return Queue;
+}
+
+FPostedMessageQueue::FPostedMessageQueue()
+{
+	Capacity = FMath::RoundUpToPowerOfTwo(FMath::Max(PostedQueue::QueueSizeKB, 4) * 1024);
+	Buffer = static_cast<uint8*>(FMemory::Malloc(Capacity, RecordAlignment));
+	FMemory::Memzero(Buffer, Capacity);
+
+	auto RegisterFlush = [] {
+		using namespace PostedQueue;
+		FWorldDelegates::OnWorldTickStart.AddLambda([](auto&&...) { TryDrain(EFlushPoint::WorldTickStart); });
+#if UE_4_23_OR_LATER
+		FWorldDelegates::OnWorldPostActorTick.AddLambda([](auto&&...) { TryDrain(EFlushPoint::PostActorTick); });
+#endif
+		FCoreDelegates::OnEndFrame.AddLambda([] { TryDrain(EFlushPoint::EndFrame); });
+	};
+	if (IsInGameThread())
+		RegisterFlush();
+	else
+		AsyncTask(ENamedThreads::GameThread, RegisterFlush);
+}
+
+FPostedMessageQueue::~FPostedMessageQueue()
+{
+	using namespace PostedQueue;
+	// drop what is left without sending
+	for (uint64 Cursor = Tail.load(); Cursor < Head.load();)
+	{
+		auto Header = reinterpret_cast<FRecordHeader*>(Buffer + (Cursor & (Capacity - 1)));
+		if (!Header->Size)
+			break;
+		if (Header->State == ERecordState::Ready)
+			Header->Dispatch(Header + 1, false);
+		Cursor += Header->Size;
+	}
+	FMemory::Free(Buffer);
+}
+
+void* FPostedMessageQueue::Reserve(uint32 PayloadSize)
+{
+	using namespace PostedQueue;
+	const uint64 RecordSize = Align(sizeof(FRecordHeader) + PayloadSize, RecordAlignment);
+	if (!ensure(RecordSize <= Capacity / 2))
+		return nullptr;
+
+	uint64 OldHead = Head.load(std::memory_order_relaxed);
+	uint64 NewHead;
+	uint64 Pos;
+	uint64 PaddingSize;
+	do
+	{
+		Pos = OldHead & (Capacity - 1);
+		PaddingSize = (Pos + RecordSize > Capacity) ? Capacity - Pos : 0;
+		NewHead = OldHead + PaddingSize + RecordSize;
+		if (NewHead - Tail.load(std::memory_order_acquire) > Capacity)
+		{
+			++DroppedNum;
+			return nullptr;
+		}
+	} while (!Head.compare_exchange_weak(OldHead, NewHead, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	if (PaddingSize)
+	{
+		auto Padding = reinterpret_cast<FRecordHeader*>(Buffer + Pos);
+		Padding->Size = PaddingSize;
+		FPlatformAtomics::InterlockedExchange(&Padding->State, ERecordState::Padding);
+		Pos = 0;
+	}
+
+	auto Header = reinterpret_cast<FRecordHeader*>(Buffer + Pos);
+	Header->Size = RecordSize;
+	return Header + 1;
+}
+
+void FPostedMessageQueue::Commit(void* Payload, FDispatchFunc Func)
+{
+	using namespace PostedQueue;
+	auto Header = static_cast<FRecordHeader*>(Payload) - 1;
+	Header->Dispatch = Func;
+	FPlatformAtomics::InterlockedExchange(&Header->State, ERecordState::Ready);
+}
+
+int32 FPostedMessageQueue::Drain()
+{
+	using namespace PostedQueue;
+	check(IsInGameThread());
+	if (bDraining)
+		return 0;
+	TGuardValue<bool> DrainingGuard(bDraining, true);
+
+	if (int32 Dropped = DroppedNum.exchange(0))
+		GMP_WARNING(TEXT("FPostedMessageQueue full, %d posted messages dropped, consider raising GMP.PostedMessageQueueSize"), Dropped);
+
+	// messages posted by listeners wait for the next drain
+	const uint64 End = Head.load(std::memory_order_acquire);
+	uint64 Cursor = Tail.load(std::memory_order_relaxed);
+	int32 Count = 0;
+	while (Cursor < End)
+	{
+		auto Header = reinterpret_cast<FRecordHeader*>(Buffer + (Cursor & (Capacity - 1)));
+		const int32 State = FPlatformAtomics::AtomicRead(&Header->State);
+		if (State == ERecordState::Writing)
+			break;
+
+		const uint32 Size = Header->Size;
+		if (State == ERecordState::Ready)
+		{
+			Header->Dispatch(Header + 1, true);
+			++Count;
+		}
+
+		// producers expect zeroed headers wherever a record may start
+		FMemory::Memzero(Header, Size);
+		Cursor += Size;
+		Tail.store(Cursor, std::memory_order_release);
+	}
+	return Count;
+}
+}  // namespace GMP
@@ -30,6 +30,41 @@ static TMap<FName, TSet<FName>> NativeParentsInfo;
 static TSet<FName> UnSupportedName;
 static TMap<FName, TSet<FName>> ParentsInfo;
 
+// (lhs, rhs) results of the FNameSuccession queries, dropped whenever class infos are added or reloaded
+namespace TypeMemo
+{
+	enum class EQuery : uint8
+	{
+		DerivedFrom,
+		MatchEnums,
+		TypeCompatible,
+	};
+	static uint32 InfoVersion = 0;
+	static uint32 MemoVersion = 0;
+	static TMap<TTuple<FName, FName, EQuery>, bool> Results;
+
+	static void Invalidate() { ++InfoVersion; }
+
+	template<typename F>
+	static bool FindOrCompute(EQuery Query, FName Lhs, FName Rhs, const F& Compute)
+	{
+		if (MemoVersion != InfoVersion)
+		{
+			Results.Reset();
+			MemoVersion = InfoVersion;
+		}
+
+		const auto Key = MakeTuple(Lhs, Rhs, Query);
+		if (auto Find = Results.Find(Key))
+			return *Find;
+
+		const bool bResult = Compute();
+		if (MemoVersion == InfoVersion)
+			Results.Add(Key, bResult);
+		return bResult;
+	}
+}  // namespace TypeMemo
+
 static const TSet<FName>* GetClassInfos(FName InClassName)
 {
 	if(UnSupportedName.Contains(InClassName))
@@ -55,7 +90,9 @@ static const TSet<FName>* GetClassInfos(FName InClassName)
 
 FName FNameSuccession::GetClassName(UClass* InClass)
 {
-	auto TypeName = InClass->IsNative() ? *InClass->GetName() : *FSoftClassPath(InClass).ToString();
+	FName TypeName = InClass->IsNative() ? *InClass->GetName() : *FSoftClassPath(InClass).ToString();
+	if (!ParentsInfo.Contains(TypeName))
+		TypeMemo::Invalidate();
 	auto& Set = ParentsInfo.Emplace(TypeName);
 	do
 	{
@@ -71,6 +108,7 @@ FName FNameSuccession::GetNativeClassName(UClass* InClass)
 	auto TypeName = InClass->GetFName();
 	if (!NativeParentsInfo.Contains(TypeName))
 	{
+		TypeMemo::Invalidate();
 		auto& Set = NativeParentsInfo.Emplace(TypeName);
 		do
 		{
@@ -86,6 +124,7 @@ FName FNameSuccession::GetNativeClassPtrName(UClass* InClass)
 	auto TypeName = InClass->GetFName();
 	if (!NativeParentsInfo.Contains(TypeName))
 	{
+		TypeMemo::Invalidate();
 		auto& Set = NativeParentsInfo.Emplace(TypeName);
 		do
 		{
@@ -103,24 +142,35 @@ namespace Reflection
 
 bool FNameSuccession::MatchEnums(FName IntType, FName EnumType)
 {
-	auto Bytes = Reflection::IsInterger(IntType);
-	return !!Bytes && Reflection::MatchEnum(Bytes, EnumType);
+	return TypeMemo::FindOrCompute(TypeMemo::EQuery::MatchEnums, IntType, EnumType, [&] {
+		auto Bytes = Reflection::IsInterger(IntType);
+		return !!Bytes && Reflection::MatchEnum(Bytes, EnumType);
+	});
 }
 
 bool FNameSuccession::IsDerivedFrom(FName Type, FName ParentType)
 {
-	auto FindNative = NativeParentsInfo.Find(Type);
-	if (FindNative && FindNative->Contains(ParentType))
-		return true;
+	return TypeMemo::FindOrCompute(TypeMemo::EQuery::DerivedFrom, Type, ParentType, [&] {
+		auto FindNative = NativeParentsInfo.Find(Type);
+		if (FindNative && FindNative->Contains(ParentType))
+			return true;
 
-	if (auto Find = GetClassInfos(Type))
-	{
-		return Find->Contains(ParentType);
-	}
-	return false;
+		if (auto Find = GetClassInfos(Type))
+		{
+			return Find->Contains(ParentType);
+		}
+		return false;
+	});
 }
 
 bool FNameSuccession::IsTypeCompatible(FName lhs, FName rhs)
+{
+	if (lhs == rhs)
+		return true;
+	return TypeMemo::FindOrCompute(TypeMemo::EQuery::TypeCompatible, lhs, rhs, [&] { return IsTypeCompatibleImpl(lhs, rhs); });
+}
+
+bool FNameSuccession::IsTypeCompatibleImpl(FName lhs, FName rhs)
 {
 	do
 	{
@@ -176,17 +226,27 @@ public:
 
 		using namespace GMP;
 		Class2Prop::InitPropertyMapBase();
-#if WITH_EDITOR
+#if !WITH_EDITOR
+		// enums and blueprint classes loaded with the next map may resolve names which failed before
+		FCoreUObjectDelegates::PreLoadMap.AddLambda([](const FString& MapName) { TypeMemo::Invalidate(); });
+#else
 		if (TrueOnFirstCall([] {}))
 		{
 			static auto EmptyInfo = [] {
 				ParentsInfo.Empty();
 				UnSupportedName.Empty();
+				TypeMemo::Invalidate();
 			};
 
 			FCoreUObjectDelegates::PreLoadMap.AddLambda([](const FString& MapName) { EmptyInfo(); });
 			if (GIsEditor)
 				FEditorDelegates::PreBeginPIE.AddLambda([](bool bIsSimulating) { EmptyInfo(); });
+
+			// reinstanced blueprint or hot reloaded classes may change the hierarchy behind a name
+			FCoreUObjectDelegates::OnObjectsReplaced.AddLambda([](const TMap<UObject*, UObject*>&) { EmptyInfo(); });
+#if UE_4_27_OR_LATER
+			FCoreUObjectDelegates::ReloadCompleteDelegate.AddLambda([](EReloadCompleteReason) { EmptyInfo(); });
+#endif
 		}
 #endif
 	}
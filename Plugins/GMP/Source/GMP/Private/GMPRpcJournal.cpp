@@ -0,0 +1,250 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#include "GMPRpcJournal.h"
+
+#include "GMPUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UnrealCompatibility.h"
+
+namespace GMP
+{
+bool FRpcJournal::bEnabled = false;
+
+namespace RpcJournal
+{
+	enum : uint32
+	{
+		FileMagic = 0x4A504D47,  // GMPJ
+		RecordMagic = 0x52504D47,  // GMPR
+		Version = 1,
+		StagingFlushBytes = 256 * 1024,
+	};
+
+	// file layout: header then a data area of Capacity bytes written round robin, Head counts all bytes ever written
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Capacity;
+		uint64 Head;
+		double StartTime;
+	};
+
+	// followed by the ansi message name and the payload, Crc covers everything after itself
+	struct FRecordHeader
+	{
+		uint32 Magic;
+		uint32 Size;
+		uint32 Crc;
+		uint32 Connection;
+		double Time;
+		uint32 MessageId;
+		uint16 NameLen;
+		uint8 Direction;
+		uint8 Pad;
+	};
+	static_assert(sizeof(FRecordHeader) == 32, "err");
+
+	static int32 JournalMB = 32;
+	static FAutoConsoleVariableRef CVar_JournalMB(TEXT("GMP.RpcJournalMB"), JournalMB, TEXT("size in MB of the rpc journal ring file, read when the journal opens"), ECVF_Default);
+
+	struct FWriter
+	{
+		TUniquePtr<IFileHandle> File;
+		FFileHeader Header;
+		TArray<uint8> Staging;
+		bool bFailed = false;
+
+		bool Open()
+		{
+			if (File)
+				return true;
+			if (bFailed)
+				return false;
+
+			const FString Path = FPaths::ProjectSavedDir() / TEXT("GMP") / FString::Printf(TEXT("RpcJournal-%s.gmpj"), *FDateTime::Now().ToString());
+			IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+			File.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Path));
+			if (!File)
+			{
+				bFailed = true;
+				GMP_WARNING(TEXT("failed to open rpc journal %s"), *Path);
+				return false;
+			}
+
+			Header = FFileHeader{FileMagic, Version, uint64(FMath::Max(JournalMB, 1)) * 1024 * 1024, 0, FPlatformTime::Seconds()};
+			WriteHeader();
+			GMP_LOG(TEXT("rpc journal opened %s"), *Path);
+			return true;
+		}
+
+		void WriteHeader()
+		{
+			File->Seek(0);
+			File->Write((const uint8*)&Header, sizeof(Header));
+		}
+
+		void Flush()
+		{
+			if (!File || !Staging.Num())
+				return;
+
+			const uint8* Data = Staging.GetData();
+			uint64 Remain = Staging.Num();
+			// only the newest Capacity bytes survive anyway
+			if (Remain > Header.Capacity)
+			{
+				Header.Head += Remain - Header.Capacity;
+				Data += Remain - Header.Capacity;
+				Remain = Header.Capacity;
+			}
+			while (Remain > 0)
+			{
+				const uint64 Offset = Header.Head % Header.Capacity;
+				const uint64 Size = FMath::Min(Remain, Header.Capacity - Offset);
+				File->Seek(sizeof(FFileHeader) + Offset);
+				File->Write(Data, Size);
+				Data += Size;
+				Remain -= Size;
+				Header.Head += Size;
+			}
+			WriteHeader();
+			File->Flush();
+			Staging.Reset();
+		}
+
+		void Close()
+		{
+			Flush();
+			File.Reset();
+			bFailed = false;
+		}
+	};
+	static FWriter Writer;
+
+	static void OnEndFrame()
+	{
+		if (FRpcJournal::IsEnabled())
+			Writer.Flush();
+		else if (Writer.File)
+			Writer.Close();
+	}
+}  // namespace RpcJournal
+
+struct FRpcJournalCVars
+{
+	FRpcJournalCVars()
+		: CVar_Journal(TEXT("GMP.RpcJournal"), FRpcJournal::bEnabled, TEXT("record sent and received rpc message payloads to Saved/GMP/RpcJournal-*.gmpj"), ECVF_Default)
+		, CVar_Flush(TEXT("GMP.RpcJournalFlush"), TEXT("write staged rpc journal records to disk now"), FConsoleCommandDelegate::CreateStatic(&FRpcJournal::Flush))
+	{
+		FCoreDelegates::OnEndFrame.AddStatic(&RpcJournal::OnEndFrame);
+		FCoreDelegates::OnPreExit.AddStatic(&FRpcJournal::Close);
+	}
+	FAutoConsoleVariableRef CVar_Journal;
+	FAutoConsoleCommand CVar_Flush;
+};
+static FRpcJournalCVars RpcJournalCVars;
+
+void FRpcJournal::Record(EDirection Direction, uint32 Connection, FName MessageName, uint32 MessageId, const TArray<uint8>& Buffer)
+{
+	using namespace RpcJournal;
+	checkSlow(IsInGameThread());
+	if (!bEnabled || !Writer.Open())
+		return;
+
+	const FString NameStr = MessageName.ToString();
+	const auto Name = StringCast<ANSICHAR>(*NameStr);
+	const uint16 NameLen = (uint16)FMath::Min(Name.Length(), int32(MAX_uint16));
+
+	FRecordHeader Header;
+	Header.Magic = RecordMagic;
+	Header.Size = sizeof(FRecordHeader) + NameLen + Buffer.Num();
+	Header.Crc = 0;
+	Header.Connection = Connection;
+	Header.Time = FPlatformTime::Seconds() - Writer.Header.StartTime;
+	Header.MessageId = MessageId;
+	Header.NameLen = NameLen;
+	Header.Direction = Direction;
+	Header.Pad = 0;
+
+	const int32 Offset = Writer.Staging.AddUninitialized(Header.Size);
+	uint8* Dst = Writer.Staging.GetData() + Offset;
+	FMemory::Memcpy(Dst + sizeof(FRecordHeader), Name.Get(), NameLen);
+	FMemory::Memcpy(Dst + sizeof(FRecordHeader) + NameLen, Buffer.GetData(), Buffer.Num());
+	FMemory::Memcpy(Dst, &Header, sizeof(FRecordHeader));
+	const uint32 CrcOffset = STRUCT_OFFSET(FRecordHeader, Connection);
+	Header.Crc = FCrc::MemCrc32(Dst + CrcOffset, Header.Size - CrcOffset);
+	FMemory::Memcpy(Dst + STRUCT_OFFSET(FRecordHeader, Crc), &Header.Crc, sizeof(Header.Crc));
+
+	if (Writer.Staging.Num() >= StagingFlushBytes)
+		Writer.Flush();
+}
+
+void FRpcJournal::Flush()
+{
+	RpcJournal::Writer.Flush();
+}
+
+void FRpcJournal::Close()
+{
+	RpcJournal::Writer.Close();
+}
+
+bool FRpcJournal::Load(const FString& Path, TArray<FRecord>& OutRecords)
+{
+	using namespace RpcJournal;
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path) || Bytes.Num() < (int32)sizeof(FFileHeader))
+		return false;
+
+	FFileHeader Header;
+	FMemory::Memcpy(&Header, Bytes.GetData(), sizeof(Header));
+	if (Header.Magic != FileMagic || Header.Version != Version || Header.Capacity == 0)
+		return false;
+
+	// unroll the ring so the oldest byte comes first
+	const uint64 Written = FMath::Min(Header.Head, Header.Capacity);
+	const uint64 Start = Header.Head > Header.Capacity ? Header.Head % Header.Capacity : 0;
+	if (uint64(Bytes.Num()) < sizeof(FFileHeader) + FMath::Max(Written, Start))
+		return false;
+
+	TArray<uint8> Data;
+	Data.SetNumUninitialized(Written);
+	const uint8* Ring = Bytes.GetData() + sizeof(FFileHeader);
+	FMemory::Memcpy(Data.GetData(), Ring + Start, Written - Start);
+	FMemory::Memcpy(Data.GetData() + (Written - Start), Ring, Start);
+
+	// the first record may have been partly overwritten, resync on the next valid one
+	const uint32 CrcOffset = STRUCT_OFFSET(FRecordHeader, Connection);
+	int64 Pos = 0;
+	while (Pos + (int64)sizeof(FRecordHeader) <= Data.Num())
+	{
+		FRecordHeader Rec;
+		FMemory::Memcpy(&Rec, Data.GetData() + Pos, sizeof(Rec));
+		const bool bValid = Rec.Magic == RecordMagic && Rec.Size >= sizeof(FRecordHeader) + Rec.NameLen && Pos + Rec.Size <= Data.Num()
+							&& FCrc::MemCrc32(Data.GetData() + Pos + CrcOffset, Rec.Size - CrcOffset) == Rec.Crc;
+		if (!bValid)
+		{
+			++Pos;
+			continue;
+		}
+
+		const uint8* Name = Data.GetData() + Pos + sizeof(FRecordHeader);
+		auto& Record = Add_GetRef(OutRecords);
+		Record.Time = Rec.Time;
+		Record.Connection = Rec.Connection;
+		Record.Direction = (EDirection)Rec.Direction;
+		Record.MessageId = Rec.MessageId;
+		Record.MessageName = FName(FString(Rec.NameLen, (const ANSICHAR*)Name));
+		Record.Buffer.Append(Name + Rec.NameLen, Rec.Size - sizeof(FRecordHeader) - Rec.NameLen);
+		Pos += Rec.Size;
+	}
+	return true;
+}
+}  // namespace GMP
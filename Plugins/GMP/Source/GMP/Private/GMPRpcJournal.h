@@ -0,0 +1,41 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+
+namespace GMP
+{
+// opt-in ring file of rpc message payloads as they go over the wire, game thread only
+// records are staged in memory and written once per frame, the oldest ones get overwritten when the ring is full
+class FRpcJournal
+{
+public:
+	enum EDirection : uint8
+	{
+		Outgoing,
+		Incoming,
+	};
+
+	struct FRecord
+	{
+		double Time;
+		uint32 Connection;
+		EDirection Direction;
+		uint32 MessageId;
+		FName MessageName;
+		TArray<uint8> Buffer;
+	};
+
+	static FORCEINLINE bool IsEnabled() { return bEnabled; }
+	static void Record(EDirection Direction, uint32 Connection, FName MessageName, uint32 MessageId, const TArray<uint8>& Buffer);
+	static void Flush();
+	static void Close();
+
+	// oldest first, records torn by the wrap of the ring are skipped
+	static bool Load(const FString& Path, TArray<FRecord>& OutRecords);
+
+private:
+	static bool bEnabled;
+	friend struct FRpcJournalCVars;
+};
+}  // namespace GMP
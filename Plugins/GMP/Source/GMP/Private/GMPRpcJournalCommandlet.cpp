@@ -0,0 +1,125 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#include "GMPRpcJournalCommandlet.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GMPRpcJournal.h"
+#include "GMPRpcProxy.h"
+#include "GMPUtils.h"
+#include "Misc/NetworkGuid.h"
+
+bool UGMPJournalPackageMap::SerializeObject(FArchive& Ar, UClass* InClass, UObject*& Obj, FNetworkGUID* OutNetGUID)
+{
+	check(Ar.IsLoading());
+	enum : uint8
+	{
+		HasPath = 1 << 0,
+		HasNetworkChecksum = 1 << 2,
+	};
+
+	// net guid, then for the default guid the export flags and path chain with the outers first
+	FNetworkGUID NetGUID;
+	Ar << NetGUID;
+	if (NetGUID.IsDefault() && !Ar.IsError())
+	{
+		uint8 ExportFlags = 0;
+		Ar << ExportFlags;
+		if (ExportFlags & HasPath)
+		{
+			UObject* Outer = nullptr;
+			SerializeObject(Ar, UObject::StaticClass(), Outer);
+			FString PathName;
+			Ar << PathName;
+			if (ExportFlags & HasNetworkChecksum)
+			{
+				uint32 NetworkChecksum = 0;
+				Ar << NetworkChecksum;
+			}
+		}
+	}
+
+	++ObjectRefNum;
+	Obj = nullptr;
+	if (OutNetGUID)
+		*OutNetGUID = NetGUID;
+	return !Ar.IsError();
+}
+
+UGMPRpcJournalCommandlet::UGMPRpcJournalCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UGMPRpcJournalCommandlet::Main(const FString& Params)
+{
+	using namespace GMP;
+	FString Path;
+	if (!FParse::Value(*Params, TEXT("Journal="), Path))
+	{
+		GMP_WARNING(TEXT("usage: -run=GMPRpcJournal -Journal=<path.gmpj> [-Repeat=N] [-Outgoing]"));
+		return 1;
+	}
+	int32 Repeat = 1;
+	FParse::Value(*Params, TEXT("Repeat="), Repeat);
+	const bool bOutgoing = FParse::Param(*Params, TEXT("Outgoing"));
+
+	TArray<FRpcJournal::FRecord> Records;
+	if (!FRpcJournal::Load(Path, Records))
+	{
+		GMP_WARNING(TEXT("failed to load rpc journal %s"), *Path);
+		return 1;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("GMPRpcJournalReplay"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	FMessageUtils::NotifyWorldMessage(World, MSGKEY("GMP.OnRpcJournalReplay"), World);
+
+	auto PackageMap = NewObject<UGMPJournalPackageMap>(World);
+	struct FMessageStats
+	{
+		int32 Num = 0;
+		int32 Failed = 0;
+		double Seconds = 0.0;
+	};
+	TMap<FName, FMessageStats> Stats;
+	int32 Skipped = 0;
+	double TotalSeconds = 0.0;
+	for (int32 Round = 0; Round < FMath::Max(Repeat, 1); ++Round)
+	{
+		for (auto& Record : Records)
+		{
+			if (!bOutgoing && Record.Direction != FRpcJournal::Incoming)
+				continue;
+
+			auto Layout = UGMPRpcValidation::Find(World, Record.MessageName);
+			if (!Layout.IsValid())
+			{
+				++Skipped;
+				continue;
+			}
+
+			auto& Stat = Stats.FindOrAdd(Record.MessageName);
+			const double BeginTime = FPlatformTime::Seconds();
+			const bool bSucc = UGMPRpcProxy::DecodeMessage(Record.MessageName, *Layout, PackageMap, World, Record.Buffer);
+			const double Seconds = FPlatformTime::Seconds() - BeginTime;
+			++Stat.Num;
+			Stat.Failed += bSucc ? 0 : 1;
+			Stat.Seconds += Seconds;
+			TotalSeconds += Seconds;
+		}
+	}
+
+	Stats.ValueSort([](const FMessageStats& Lhs, const FMessageStats& Rhs) { return Lhs.Seconds > Rhs.Seconds; });
+	for (auto& Pair : Stats)
+		GMP_LOG(TEXT("GMPRpcJournal %s : %d replayed, %d failed, %.3f us avg"), *Pair.Key.ToString(), Pair.Value.Num, Pair.Value.Failed, Pair.Value.Num ? 1e6 * Pair.Value.Seconds / Pair.Value.Num : 0.0);
+	GMP_LOG(TEXT("GMPRpcJournal %d records, %d skipped without layout, %d object refs, %.3f ms total"), Records.Num(), Skipped, PackageMap->ObjectRefNum, 1e3 * TotalSeconds);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return 0;
+}
@@ -0,0 +1,33 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Commandlets/Commandlet.h"
+#include "UObject/CoreNet.h"
+
+#include "GMPRpcJournalCommandlet.generated.h"
+
+// reads object references the way a client package map wrote them, they decode as null offline
+UCLASS(Transient)
+class UGMPJournalPackageMap : public UPackageMap
+{
+	GENERATED_BODY()
+public:
+	virtual bool SerializeObject(FArchive& Ar, UClass* InClass, UObject*& Obj, FNetworkGUID* OutNetGUID = nullptr) override;
+
+	int32 ObjectRefNum = 0;
+};
+
+// replays incoming messages of an rpc journal against a headless world
+// -Journal=<path.gmpj> [-Repeat=N] [-Outgoing]
+// listeners and rpc layouts are expected from handlers of GMP.OnRpcJournalReplay, which is sent with the world before replay
+UCLASS()
+class UGMPRpcJournalCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UGMPRpcJournalCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
@@ -2,6 +2,7 @@
 
 #include "GMPRpcProxy.h"
 
+#include "Engine/ActorChannel.h"
 #include "Engine/Engine.h"
 #include "Engine/GameEngine.h"
 #include "Engine/GameInstance.h"
@@ -9,10 +10,15 @@
 #include "Engine/World.h"
 #include "GMPArchive.h"
 #include "GMPBPLib.h"
+#include "GMPRpcJournal.h"
 #include "GMPRpcUtils.h"
+#include "GMPTickBase.h"
 #include "GMPWorldLocals.h"
 #include "GameFramework/GameModeBase.h"
 #include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Compression.h"
 #include "Stats/Stats2.h"
 #include "Templates/SharedPointer.h"
 #include "TimerManager.h"
@@ -48,25 +54,57 @@ inline auto& GMPRpcProcessors(const UObject* WorldContextObj)
 	return GMPRpcValidation(WorldContextObj).RPCProcessors;
 }
 
+FGMPRpcLayout::FGMPRpcLayout(const TArray<FProperty*>& InProps)
+	: Props(InProps)
+{
+	for (FProperty* Prop : Props)
+	{
+		const int32 PropAlignment = FMath::Max(Prop->GetMinAlignment(), 1);
+		TotalSize = Align(TotalSize, PropAlignment);
+		Alignment = FMath::Max(Alignment, PropAlignment);
+		Offsets.Add(TotalSize);
+		TotalSize += Prop->ElementSize;
+
+		uint8 PropFlags = 0;
+		if (Prop->HasAnyPropertyFlags(CPF_ZeroConstructor))
+			PropFlags |= ZeroInit;
+		if (Prop->HasAnyPropertyFlags(CPF_NoDestructor | CPF_IsPlainOldData))
+			PropFlags |= NoDestructor;
+		auto ByteProp = CastField<FByteProperty>(Prop);
+		if (CastField<FNumericProperty>(Prop) && !(ByteProp && ByteProp->Enum))
+			PropFlags |= RawBytes;
+		Flags.Add(PropFlags);
+		bNeedsDestroy |= !(PropFlags & NoDestructor);
+	}
+
+	const bool bAllRaw = Props.Num() > 0 && !Flags.ContainsByPredicate([](uint8 PropFlags) { return !(PropFlags & RawBytes); });
+	if (bAllRaw)
+	{
+		for (FProperty* Prop : Props)
+			RawPackBytes += Prop->ElementSize;
+	}
+}
+
 bool UGMPRpcValidation::VerifyRpc(const UObject* Obj, const FName& MessageName, const TArray<FProperty*>& Props)
 {
 	auto& Processors = GMPRpcProcessors(Obj);
 	if (auto Find = Processors.Find(MessageName))
 	{
 		// Must ExactMatched
-		if (!ensureWorldMsgf(Obj, *Find == Props, TEXT("RPC Must ExactMatched :%s "), *MessageName.ToString()))
+		if (!ensureWorldMsgf(Obj, (*Find)->Props == Props, TEXT("RPC Must ExactMatched :%s "), *MessageName.ToString()))
 			return false;
 	}
 	else
 	{
-		Processors.Add(MessageName, Props);
+		Processors.Add(MessageName, MakeShared<FGMPRpcLayout>(Props));
 	}
 	return true;
 }
 
-const TArray<FProperty*>* UGMPRpcValidation::Find(const UObject* Obj, const FName& MessageKey)
+FGMPRpcLayoutPtr UGMPRpcValidation::Find(const UObject* Obj, const FName& MessageKey)
 {
-	return GMPRpcProcessors(Obj).Find(MessageKey);
+	auto Find = GMPRpcProcessors(Obj).Find(MessageKey);
+	return Find ? *Find : FGMPRpcLayoutPtr();
 }
 
 int32 UGMPRpcValidation::GetNextPlayerSequence(const APlayerController& PC)
@@ -75,11 +113,335 @@ int32 UGMPRpcValidation::GetNextPlayerSequence(const APlayerController& PC)
 }
 
 //////////////////////////////////////////////////////////////////////////
+namespace GMP
+{
+namespace RpcProxy
+{
+	static bool bUseMessageIds = true;
+	static FAutoConsoleVariableRef CVar_UseMessageIds(TEXT("GMP.RpcMessageIds"), bUseMessageIds, TEXT("send rpc message keys as per connection indices once they are defined"), ECVF_Default);
+
+	// bounds the dictionary a remote peer can make us hold
+	static const uint32 MaxMessageIds = 4096;
+
+	static int32 FragmentBytesPerTick = 16 * 1024;
+	static FAutoConsoleVariableRef CVar_FragmentBytesPerTick(TEXT("GMP.RpcFragmentBytesPerTick"), FragmentBytesPerTick, TEXT("bytes of fragmented rpc messages sent per proxy each tick, 0 sends all at once"), ECVF_Default);
+
+	// a channel closes once its reliable buffer of 256 unacked bunches overflows
+	static int32 FragmentMaxOutReliable = 64;
+	static FAutoConsoleVariableRef CVar_FragmentMaxOutReliable(TEXT("GMP.RpcFragmentMaxOutReliable"), FragmentMaxOutReliable, TEXT("fragments wait while the proxy owner's channel has this many unacked reliable bunches, 0 does not wait"), ECVF_Default);
+
+	static int32 ReassemblyMaxKB = 4096;
+	static FAutoConsoleVariableRef CVar_ReassemblyMaxKB(TEXT("GMP.RpcReassemblyMaxKB"), ReassemblyMaxKB, TEXT("max KB of partially received rpc messages held per proxy, larger messages are not sent either"), ECVF_Default);
+
+	static bool IsReliableBufferFull(const UActorComponent* Comp)
+	{
+		if (FragmentMaxOutReliable <= 0)
+			return false;
+		AActor* Owner = Comp->GetOwner();
+		UNetConnection* Connection = Owner ? Owner->GetNetConnection() : nullptr;
+#if UE_4_22_OR_LATER
+		UActorChannel* Channel = Connection ? Connection->FindActorChannelRef(Owner) : nullptr;
+#else
+		UActorChannel* Channel = Connection ? Connection->ActorChannels.FindRef(Owner) : nullptr;
+#endif
+		return Channel && Channel->NumOutRec >= FragmentMaxOutReliable;
+	}
+
+	static bool bAutoBatch = false;
+	static FAutoConsoleVariableRef CVar_AutoBatch(TEXT("GMP.RpcAutoBatch"), bAutoBatch, TEXT("coalesce rpcs sent outside of batch scopes and send them once per frame"), ECVF_Default);
+
+	static int32 AutoBatchBytes = 2048;
+	static FAutoConsoleVariableRef CVar_AutoBatchBytes(TEXT("GMP.RpcAutoBatchBytes"), AutoBatchBytes, TEXT("bytes after which an auto batch lane is sent before the end of frame"), ECVF_Default);
+
+	static int32 BatchMaxKB = 4096;
+	static FAutoConsoleVariableRef CVar_BatchMaxKB(TEXT("GMP.RpcBatchMaxKB"), BatchMaxKB, TEXT("max KB of message payloads accepted in one received rpc batch"), ECVF_Default);
+
+	static TArray<TWeakObjectPtr<UGMPRpcProxy>> AutoBatchProxies;
+
+	// keys are only compared, a stale entry fails the owner check and gets replaced
+	static TMap<const APlayerController*, TWeakObjectPtr<UGMPRpcProxy>> ProxyTable;
+	// the proxy of the outermost open batch scope
+	static TWeakObjectPtr<UGMPRpcProxy> PinnedProxy;
+
+	enum EBatchCodec : uint8
+	{
+		None,
+		Zlib,
+		LZ4,
+		Num,
+	};
+	static int32 BatchCodec = EBatchCodec::LZ4;
+	static FAutoConsoleVariableRef CVar_BatchCodec(TEXT("GMP.RpcBatchCodec"), BatchCodec, TEXT("codec of batched rpc payloads: 0 none, 1 zlib, 2 lz4"), ECVF_Default);
+
+	static int32 BatchCompressBytes = 256;
+	static FAutoConsoleVariableRef CVar_BatchCompressBytes(TEXT("GMP.RpcBatchCompressBytes"), BatchCompressBytes, TEXT("batched rpc payloads smaller than this are sent uncompressed"), ECVF_Default);
+
+	// bounds what a remote peer can make us allocate for one batch
+	static const uint32 MaxBatchEntries = 4096;
+
+#if UE_4_22_OR_LATER
+	static FName GetCodecName(uint8 Codec)
+	{
+		return Codec == EBatchCodec::Zlib ? NAME_Zlib : Codec == EBatchCodec::LZ4 ? NAME_LZ4 : NAME_None;
+	}
+#endif
+
+	struct FBatchStats
+	{
+		int64 Batches = 0;
+		int64 Entries = 0;
+		int64 Objects = 0;
+		int64 Keys = 0;
+		int64 PayloadBytes = 0;
+		int64 EncodedBytes = 0;
+		int64 CompressedBatches = 0;
+
+		void Dump(FOutputDevice& Ar) const
+		{
+			Ar.Logf(TEXT("GMPRpcBatch batches %lld (compressed %lld) entries %lld"), Batches, CompressedBatches, Entries);
+			Ar.Logf(TEXT("GMPRpcBatch objects sent %lld for %lld refs, keys sent %lld"), Objects, Entries, Keys);
+			Ar.Logf(TEXT("GMPRpcBatch payload %lld bytes encoded to %lld bytes (%.1f%%)"), PayloadBytes, EncodedBytes, PayloadBytes ? 100.0 * EncodedBytes / PayloadBytes : 100.0);
+		}
+	};
+	static FBatchStats BatchStats;
+	static FAutoConsoleCommandWithOutputDevice CVar_DumpBatchStats(TEXT("GMP.DumpRpcBatchStats"), TEXT("dump how much batched rpcs shrink through the object/key tables and the payload codec"), FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar) { BatchStats.Dump(Ar); }));
+
+	static float RateTokensPerSecond = 0.f;
+	static FAutoConsoleVariableRef CVar_RateTokensPerSecond(TEXT("GMP.RpcRateTokensPerSecond"), RateTokensPerSecond, TEXT("default rpc requests per second and message key accepted from each remote client, 0 disables limiting"), ECVF_Default);
+
+	static float RateBurst = 16.f;
+	static FAutoConsoleVariableRef CVar_RateBurst(TEXT("GMP.RpcRateBurst"), RateBurst, TEXT("default rpc requests a remote client may send at once per message key"), ECVF_Default);
+
+	static int32 DeferredQueueSize = 256;
+	static FAutoConsoleVariableRef CVar_DeferredQueueSize(TEXT("GMP.RpcDeferredQueueSize"), DeferredQueueSize, TEXT("rpc requests over their rate held per proxy before new ones are dropped"), ECVF_Default);
+
+	static float DeferredBudgetMs = 1.f;
+	static FAutoConsoleVariableRef CVar_DeferredBudgetMs(TEXT("GMP.RpcDeferredBudgetMs"), DeferredBudgetMs, TEXT("milliseconds spent per frame dispatching deferred rpc requests, shared by all proxies in turn"), ECVF_Default);
+
+	struct FRatePolicy
+	{
+		float TokensPerSecond;
+		float Burst;
+		int32 Priority;
+	};
+	static TMap<FName, FRatePolicy> RatePolicies;
+
+	static FRatePolicy GetRatePolicy(FName MessageName)
+	{
+		if (auto Find = RatePolicies.Find(MessageName))
+			return *Find;
+		return FRatePolicy{RateTokensPerSecond, RateBurst, 0};
+	}
+
+	struct FRateStats
+	{
+		int64 Limited = 0;
+		int64 Deferred = 0;
+		int64 Dropped = 0;
+		int64 Dispatched = 0;
+		int32 PeakQueued = 0;
+
+		void Dump(FOutputDevice& Ar) const
+		{
+			Ar.Logf(TEXT("GMPRpcRate limited %lld deferred %lld dropped %lld deferred dispatched %lld peak queued %d"), Limited, Deferred, Dropped, Dispatched, PeakQueued);
+			for (auto& Pair : RatePolicies)
+				Ar.Logf(TEXT("GMPRpcRate policy %s : %.1f/s burst %.1f priority %d"), *Pair.Key.ToString(), Pair.Value.TokensPerSecond, Pair.Value.Burst, Pair.Value.Priority);
+		}
+	};
+	static FRateStats RateStats;
+	static FAutoConsoleCommandWithOutputDevice CVar_DumpRateStats(TEXT("GMP.DumpRpcRateStats"), TEXT("dump how many rpc requests from remote clients were deferred or dropped by rate limiting"), FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar) { RateStats.Dump(Ar); }));
+
+	// entry refs: object table index, then key table index or message id shifted left by 2 with the function/message id flags
+	enum EEntryFlags : uint32
+	{
+		EntryFunction = 1 << 0,
+		EntryMessageId = 1 << 1,
+		EntryFlagBits = 2,
+	};
+
+	static bool SaveBatch(FArchive& Ar, UPackageMap* Map, const TArray<FGMPRpcBatchData>& Entries)
+	{
+		TArray<UObject*, TInlineAllocator<8>> Objects;
+		TArray<const FString*, TInlineAllocator<8>> Keys;
+		TArray<uint32, TInlineAllocator<64>> Refs;
+		TArray<uint8> Payload;
+		for (auto& Data : Entries)
+		{
+			Refs.Add(Objects.AddUnique(Data.Obj));
+			if (!Data.bFunction && Data.KeyId)
+			{
+				Refs.Add((Data.KeyId.Index << EntryFlagBits) | EntryMessageId);
+			}
+			else
+			{
+				int32 KeyIdx = Keys.IndexOfByPredicate([&](const FString* Key) { return *Key == Data.Key; });
+				if (KeyIdx == INDEX_NONE)
+					KeyIdx = Keys.Add(&Data.Key);
+				Refs.Add((uint32(KeyIdx) << EntryFlagBits) | (Data.bFunction ? EntryFunction : 0));
+			}
+			Refs.Add(Data.Buff.Num());
+			Payload.Append(Data.Buff);
+		}
+
+		uint32 Num = Objects.Num();
+		Ar.SerializeIntPacked(Num);
+		for (UObject* Obj : Objects)
+			Map->SerializeObject(Ar, UObject::StaticClass(), Obj);
+
+		Num = Keys.Num();
+		Ar.SerializeIntPacked(Num);
+		for (const FString* Key : Keys)
+			Ar << const_cast<FString&>(*Key);
+
+		Num = Entries.Num();
+		Ar.SerializeIntPacked(Num);
+		for (uint32& Ref : Refs)
+			Ar.SerializeIntPacked(Ref);
+
+		uint8 Codec = EBatchCodec::None;
+		TArray<uint8> Compressed;
+#if UE_4_22_OR_LATER
+		if (BatchCodec > EBatchCodec::None && BatchCodec < EBatchCodec::Num && Payload.Num() >= BatchCompressBytes)
+		{
+			const FName CodecName = GetCodecName(BatchCodec);
+			int32 CompressedSize = FCompression::CompressMemoryBound(CodecName, Payload.Num());
+			Compressed.SetNumUninitialized(CompressedSize);
+			if (FCompression::CompressMemory(CodecName, Compressed.GetData(), CompressedSize, Payload.GetData(), Payload.Num()) && CompressedSize < Payload.Num())
+			{
+				Compressed.SetNum(CompressedSize, false);
+				Codec = BatchCodec;
+			}
+		}
+#endif
+		Ar << Codec;
+		uint32 RawSize = Payload.Num();
+		Ar.SerializeIntPacked(RawSize);
+		const TArray<uint8>& Encoded = Codec != EBatchCodec::None ? Compressed : Payload;
+		if (Codec != EBatchCodec::None)
+		{
+			uint32 EncodedSize = Encoded.Num();
+			Ar.SerializeIntPacked(EncodedSize);
+		}
+		Ar.Serialize(const_cast<uint8*>(Encoded.GetData()), Encoded.Num());
+
+		++BatchStats.Batches;
+		BatchStats.CompressedBatches += (Codec != EBatchCodec::None) ? 1 : 0;
+		BatchStats.Entries += Entries.Num();
+		BatchStats.Objects += Objects.Num();
+		BatchStats.Keys += Keys.Num();
+		BatchStats.PayloadBytes += Payload.Num();
+		BatchStats.EncodedBytes += Encoded.Num();
+		return !Ar.IsError();
+	}
+
+	static bool LoadBatch(FArchive& Ar, UPackageMap* Map, TArray<FGMPRpcBatchData>& Entries)
+	{
+		uint32 NumObjects = 0;
+		Ar.SerializeIntPacked(NumObjects);
+		if (NumObjects > MaxBatchEntries)
+			return false;
+		TArray<UObject*, TInlineAllocator<8>> Objects;
+		Objects.SetNumZeroed(NumObjects);
+		for (UObject*& Obj : Objects)
+			Map->SerializeObject(Ar, UObject::StaticClass(), Obj);
+
+		uint32 NumKeys = 0;
+		Ar.SerializeIntPacked(NumKeys);
+		if (NumKeys > MaxBatchEntries)
+			return false;
+		TArray<FString, TInlineAllocator<8>> Keys;
+		Keys.SetNum(NumKeys);
+		for (FString& Key : Keys)
+			Ar << Key;
+
+		uint32 NumEntries = 0;
+		Ar.SerializeIntPacked(NumEntries);
+		if (Ar.IsError() || NumEntries > MaxBatchEntries)
+			return false;
+
+		const uint64 MaxPayload = uint64(BatchMaxKB) * 1024;
+		Entries.Reset(NumEntries);
+		TArray<uint32, TInlineAllocator<64>> Sizes;
+		uint64 SumSize = 0;
+		for (uint32 Idx = 0; Idx < NumEntries; ++Idx)
+		{
+			uint32 ObjIdx = 0;
+			uint32 KeyRef = 0;
+			uint32 Size = 0;
+			Ar.SerializeIntPacked(ObjIdx);
+			Ar.SerializeIntPacked(KeyRef);
+			Ar.SerializeIntPacked(Size);
+			const uint32 KeyIdx = KeyRef >> EntryFlagBits;
+			SumSize += Size;
+			if (Ar.IsError() || ObjIdx >= NumObjects || (!(KeyRef & EntryMessageId) && KeyIdx >= NumKeys) || SumSize > MaxPayload)
+				return false;
+
+			auto& Data = Add_GetRef(Entries);
+			Data.Obj = Objects[ObjIdx];
+			Data.bFunction = !!(KeyRef & EntryFunction);
+			if (KeyRef & EntryMessageId)
+				Data.KeyId = FGMPNetMessageId(KeyIdx);
+			else
+				Data.Key = Keys[KeyIdx];
+			Sizes.Add(Size);
+		}
+
+		uint8 Codec = EBatchCodec::None;
+		uint32 RawSize = 0;
+		Ar << Codec;
+		Ar.SerializeIntPacked(RawSize);
+		if (Ar.IsError() || RawSize != SumSize)
+			return false;
+
+		TArray<uint8> Payload;
+		Payload.SetNumUninitialized(RawSize);
+		if (Codec == EBatchCodec::None)
+		{
+			Ar.Serialize(Payload.GetData(), RawSize);
+		}
+		else
+		{
+#if UE_4_22_OR_LATER
+			uint32 EncodedSize = 0;
+			Ar.SerializeIntPacked(EncodedSize);
+			if (Ar.IsError() || Codec >= EBatchCodec::Num || EncodedSize >= RawSize)
+				return false;
+			TArray<uint8> Compressed;
+			Compressed.SetNumUninitialized(EncodedSize);
+			Ar.Serialize(Compressed.GetData(), EncodedSize);
+			if (Ar.IsError() || !FCompression::UncompressMemory(GetCodecName(Codec), Payload.GetData(), RawSize, Compressed.GetData(), EncodedSize))
+				return false;
+#else
+			return false;
+#endif
+		}
+		if (Ar.IsError())
+			return false;
+
+		uint32 Offset = 0;
+		for (int32 Idx = 0; Idx < Entries.Num(); ++Idx)
+		{
+			Entries[Idx].Buff.Append(Payload.GetData() + Offset, Sizes[Idx]);
+			Offset += Sizes[Idx];
+		}
+		return true;
+	}
+}  // namespace RpcProxy
+}  // namespace GMP
+
+bool FGMPRpcBatch::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	using namespace GMP::RpcProxy;
+	bOutSuccess = Map && (Ar.IsSaving() ? SaveBatch(Ar, Map, Entries) : LoadBatch(Ar, Map, Entries));
+	return true;
+}
+
 const int32 UGMPRpcProxy::MaxByteCount = 1024;
 
 UGMPRpcProxy::UGMPRpcProxy()
 {
-	PrimaryComponentTick.bCanEverTick = false;
+	// only ticks while paced fragments are pending
+	PrimaryComponentTick.bCanEverTick = true;
 	PrimaryComponentTick.bStartWithTickEnabled = false;
 	PrimaryComponentTick.TickGroup = TG_PrePhysics;
 	bWantsInitializeComponent = true;
@@ -146,6 +508,12 @@ UGMPRpcProxy::UGMPRpcProxy()
 			GMP::FMessageUtils::NotifyWorldMessage(InWorld, MSGKEY("GMP.OnPostWorldCleanup"), InWorld, bSessionEnded, bCleanupResources);
 			// BindWorldEvent(Params.World);
 		});
+
+		// auto batches go out before the net driver flushes this tick, the end of frame catches what was sent later
+#if UE_4_23_OR_LATER
+		FWorldDelegates::OnWorldPostActorTick.AddLambda([](UWorld* InWorld, ELevelTick, float) { FlushAutoBatches(InWorld); });
+#endif
+		FCoreDelegates::OnEndFrame.AddLambda([] { FlushAutoBatches(nullptr); });
 	}
 
 #if WITH_EDITOR
@@ -171,6 +539,7 @@ void UGMPRpcProxy::InitializeComponent()
 	APlayerController* PC = GetTypedOuter<APlayerController>();
 	if (ensureWorld(this, PC))
 	{
+		RpcProxy::ProxyTable.Add(PC, this);
 		if (auto NewPawn = PC->GetPawn())
 			FMessageUtils::SendObjectMessage(NewPawn, MSGKEY("GMP.OnPlayerPossessed"), NewPawn);
 
@@ -183,6 +552,73 @@ void UGMPRpcProxy::InitializeComponent()
 	}
 }
 
+void UGMPRpcProxy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	using namespace GMP;
+	if (APlayerController* PC = GetTypedOuter<APlayerController>())
+	{
+		auto Find = RpcProxy::ProxyTable.Find(PC);
+		if (Find && (!Find->IsValid() || Find->Get() == this))
+			RpcProxy::ProxyTable.Remove(PC);
+	}
+	if (RpcProxy::PinnedProxy == this)
+		RpcProxy::PinnedProxy.Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
+UGMPRpcProxy* UGMPRpcProxy::FindProxy(const APlayerController* PC)
+{
+	using namespace GMP;
+	if (!PC)
+		return nullptr;
+
+	UGMPRpcProxy* PinnedProxy = RpcProxy::PinnedProxy.Get();
+	if (PinnedProxy && PinnedProxy->GetOuter() == PC)
+		return PinnedProxy;
+
+	if (auto Find = RpcProxy::ProxyTable.Find(PC))
+	{
+		UGMPRpcProxy* Proxy = Find->Get();
+		if (Proxy && Proxy->GetOuter() == PC)
+			return Proxy;
+	}
+
+	UGMPRpcProxy* Proxy = PC->FindComponentByClass<UGMPRpcProxy>();
+	if (Proxy)
+		RpcProxy::ProxyTable.Add(PC, Proxy);
+	else
+		RpcProxy::ProxyTable.Remove(PC);
+	return Proxy;
+}
+
+UGMPRpcProxy* UGMPRpcProxy::ResolveProxy(APlayerController* PC, const UObject* Context)
+{
+	if (PC)
+		return FindProxy(PC);
+
+	auto World = GEngine->GetWorldFromContextObject(Context, EGetWorldErrorMode::LogAndReturnNull);
+	return World && World->GetNetMode() != NM_DedicatedServer ? FindProxy(World->GetFirstPlayerController()) : nullptr;
+}
+
+int32 UGMPRpcProxy::IncreaseBatchRef(UGMPRpcProxy* Proxy)
+{
+	if (!Proxy)
+		return 0;
+	if (!GMP::RpcProxy::PinnedProxy.IsValid())
+		GMP::RpcProxy::PinnedProxy = Proxy;
+	return ++Proxy->ScopedCnt;
+}
+
+void UGMPRpcProxy::DecreaseBatchRef(UGMPRpcProxy* Proxy)
+{
+	if (Proxy && Proxy->ScopedCnt > 0 && --Proxy->ScopedCnt == 0)
+	{
+		if (GMP::RpcProxy::PinnedProxy == Proxy)
+			GMP::RpcProxy::PinnedProxy.Reset();
+		Proxy->FlushPendingRPCs();
+	}
+}
+
 void UGMPRpcProxy::BeginPlay()
 {
 	using namespace GMP;
@@ -279,23 +715,17 @@ void UGMPRpcProxy::RPC_Notify_Implementation(UObject* Object, const FString& Fun
 
 bool UGMPRpcProxy::CallFunctionRemote(APlayerController* PC, UObject* InObject, FName InFunctionName, TArray<uint8>& Buffer)
 {
-	if (auto World = GEngine->GetWorldFromContextObject(InObject, EGetWorldErrorMode::LogAndReturnNull))
+	UGMPRpcProxy* Comp = ResolveProxy(PC, InObject);
+	if (ensureWorldMsgf(InObject, Comp, TEXT("Found No Comp : %s"), *GetNameSafe(PC)))
 	{
-		bool bClient = World->GetNetMode() != NM_DedicatedServer;
-		if (!PC && bClient)
-			PC = World->GetFirstPlayerController();
-
-		UGMPRpcProxy* Comp = PC ? PC->FindComponentByClass<UGMPRpcProxy>() : nullptr;
-		if (ensureWorldMsgf(InObject, Comp, TEXT("Found No Comp : %s"), *GetNameSafe(PC)))
-		{
-			if (Comp->ScopedCnt > 0)
-				Comp->PendingRPCs.Emplace(InObject, InFunctionName.ToString(), MoveTemp(Buffer), true);
-			else if (bClient)
-				Comp->RPC_Request(InObject, InFunctionName.ToString(), Buffer);
-			else
-				Comp->RPC_Notify(InObject, InFunctionName.ToString(), Buffer);
-			return true;
-		}
+		const bool bClient = Comp->GetNetMode() != NM_DedicatedServer;
+		if (Comp->ScopedCnt > 0 || Comp->WantsAutoBatch())
+			Comp->AddPendingRPC(FGMPRpcBatchData(InObject, InFunctionName.ToString(), MoveTemp(Buffer), true), true);
+		else if (bClient)
+			Comp->RPC_Request(InObject, InFunctionName.ToString(), Buffer);
+		else
+			Comp->RPC_Notify(InObject, InFunctionName.ToString(), Buffer);
+		return true;
 	}
 	return false;
 }
@@ -303,12 +733,82 @@ bool UGMPRpcProxy::CallFunctionRemote(APlayerController* PC, UObject* InObject,
 void UGMPRpcProxy::FlushPendingRPCs()
 {
 	ScopedCnt = 0;
-	const bool bClient = (GetNetMode() != NM_DedicatedServer);
-	auto Pendings = MoveTemp(PendingRPCs);
-	if (bClient)
-		Batch_Request(Pendings);
-	else
-		Batch_Notify(Pendings);
+	if (GMP::RpcProxy::PinnedProxy == this)
+		GMP::RpcProxy::PinnedProxy.Reset();
+	SendPendingRPCs();
+}
+
+void UGMPRpcProxy::SendPendingRPCs()
+{
+	if (PendingRPCs.Num() > 0)
+	{
+		const bool bClient = (GetNetMode() != NM_DedicatedServer);
+		FGMPRpcBatch Pendings;
+		Pendings.Entries = MoveTemp(PendingRPCs);
+		PendingReliableBytes = 0;
+		if (bClient)
+			Batch_Request(Pendings);
+		else
+			Batch_Notify(Pendings);
+	}
+
+	if (PendingUnreliableRPCs.Num() > 0)
+	{
+		FGMPRpcBatch Pendings;
+		Pendings.Entries = MoveTemp(PendingUnreliableRPCs);
+		PendingUnreliableBytes = 0;
+		Unreliable_Batch_Notify(Pendings);
+	}
+}
+
+bool UGMPRpcProxy::WantsAutoBatch() const
+{
+	return GMP::RpcProxy::bAutoBatch && GetNetMode() != NM_Standalone;
+}
+
+void UGMPRpcProxy::AddPendingRPC(FGMPRpcBatchData&& Data, bool bReliable)
+{
+	using namespace GMP;
+	// scoped batches are sent as one reliable rpc when the scope ends
+	if (ScopedCnt > 0)
+	{
+		PendingRPCs.Add(MoveTemp(Data));
+		return;
+	}
+
+	int32& PendingBytes = bReliable ? PendingReliableBytes : PendingUnreliableBytes;
+	PendingBytes += Data.Buff.Num() + Data.Key.Len();
+	(bReliable ? PendingRPCs : PendingUnreliableRPCs).Add(MoveTemp(Data));
+
+	if (PendingBytes >= RpcProxy::AutoBatchBytes)
+	{
+		SendPendingRPCs();
+	}
+	else if (!bAutoBatchQueued)
+	{
+		bAutoBatchQueued = true;
+		RpcProxy::AutoBatchProxies.Add(this);
+	}
+}
+
+void UGMPRpcProxy::FlushAutoBatches(UWorld* InWorld)
+{
+	using namespace GMP;
+	auto& Proxies = RpcProxy::AutoBatchProxies;
+	for (int32 Idx = Proxies.Num() - 1; Idx >= 0; --Idx)
+	{
+		UGMPRpcProxy* Proxy = Proxies[Idx].Get();
+		if (Proxy && InWorld && Proxy->GetWorld() != InWorld)
+			continue;
+
+		Proxies.RemoveAtSwap(Idx);
+		if (Proxy)
+		{
+			Proxy->bAutoBatchQueued = false;
+			if (Proxy->ScopedCnt == 0)
+				Proxy->SendPendingRPCs();
+		}
+	}
 }
 
 void UGMPRpcProxy::DispatchPendingProgress(const TArray<FGMPRpcBatchData>& Batcher)
@@ -318,46 +818,77 @@ void UGMPRpcProxy::DispatchPendingProgress(const TArray<FGMPRpcBatchData>& Batch
 		if (Data.bFunction)
 			CallLocalFunction(Data.Obj, *Data.Key, Data.Buff);
 		else
-			CallLocalMessage(Data.Obj, Data.Key, Data.Buff);
+			CallLocalMessage(Data.Obj, Data.Key, Data.KeyId, Data.Buff);
 	}
 }
 
-bool UGMPRpcProxy::Batch_Request_Validate(const TArray<FGMPRpcBatchData>& Batcher)
+bool UGMPRpcProxy::Batch_Request_Validate(const FGMPRpcBatch& Batcher)
 {
 	return true;
 }
 
-void UGMPRpcProxy::Batch_Request_Implementation(const TArray<FGMPRpcBatchData>& Batcher)
+void UGMPRpcProxy::Batch_Request_Implementation(const FGMPRpcBatch& Batcher)
+{
+	DispatchPendingProgress(Batcher.Entries);
+}
+
+void UGMPRpcProxy::Batch_Notify_Implementation(const FGMPRpcBatch& Batcher)
 {
-	DispatchPendingProgress(Batcher);
+	DispatchPendingProgress(Batcher.Entries);
 }
 
-void UGMPRpcProxy::Batch_Notify_Implementation(const TArray<FGMPRpcBatchData>& Batcher)
+void UGMPRpcProxy::Unreliable_Batch_Notify_Implementation(const FGMPRpcBatch& Batcher)
 {
-	DispatchPendingProgress(Batcher);
+	DispatchPendingProgress(Batcher.Entries);
 }
 
 //////////////////////////////////////////////////////////////////////////
 void UGMPRpcProxy::CallMessageRemote(APlayerController* PC, const UObject* Sender, const FString& MessageStr, TArray<uint8>& Buffer, bool bReliable)
 {
-	if (auto World = GEngine->GetWorldFromContextObject(Sender, EGetWorldErrorMode::LogAndReturnNull))
-	{
-		bool bClient = World->GetNetMode() != NM_DedicatedServer;
-		if (!PC && bClient)
-			PC = World->GetFirstPlayerController();
+	CallMessageRemote(PC, Sender, FName(*MessageStr), Buffer, bReliable);
+}
 
-		UGMPRpcProxy* Comp = PC ? PC->FindComponentByClass<UGMPRpcProxy>() : nullptr;
-		if (ensureWorldMsgf(Sender, Comp, TEXT("Found No Comp:%s"), *GetNameSafe(PC)))
+void UGMPRpcProxy::CallMessageRemote(APlayerController* PC, const UObject* Sender, FName MessageName, TArray<uint8>& Buffer, bool bReliable)
+{
+	UGMPRpcProxy* Comp = ResolveProxy(PC, Sender);
+	if (ensureWorldMsgf(Sender, Comp, TEXT("Found No Comp:%s"), *GetNameSafe(PC)))
+	{
+		const bool bClient = Comp->GetNetMode() != NM_DedicatedServer;
+		// client requests, batches and fragments are always reliable
+		const bool bFragmented = Buffer.Num() > MaxByteCount || (Comp->OutgoingFragments.Num() > 0 && (bReliable || bClient));
+		const bool bScoped = Comp->ScopedCnt > 0;
+		const bool bBatched = !bFragmented && (bScoped || Comp->WantsAutoBatch());
+		const bool bReliableLane = bReliable || bClient || bScoped || bFragmented;
+		FGMPNetMessageId MessageId = Comp->ResolveOutgoingId(MessageName, bClient, bReliableLane);
+		if (GMP::FRpcJournal::IsEnabled())
+			GMP::FRpcJournal::Record(GMP::FRpcJournal::Outgoing, Comp->GetUniqueID(), MessageName, MessageId.Index, Buffer);
+		if (bFragmented)
+		{
+			Comp->SendPendingRPCs();
+			Comp->QueueFragments(Sender, MessageName, MessageId, MoveTemp(Buffer));
+		}
+		else if (bBatched)
 		{
-			if (Comp->ScopedCnt > 0)
-				Comp->PendingRPCs.Emplace(const_cast<UObject*>(Sender), FString(MessageStr), MoveTemp(Buffer), false);
-			else if (bClient)
-				Comp->Message_Request(Sender, MessageStr, Buffer);
+			if (MessageId)
+				Comp->AddPendingRPC(FGMPRpcBatchData(const_cast<UObject*>(Sender), MessageId, MoveTemp(Buffer)), bReliableLane);
+			else
+				Comp->AddPendingRPC(FGMPRpcBatchData(const_cast<UObject*>(Sender), MessageName.ToString(), MoveTemp(Buffer), false), bReliableLane);
+		}
+		else if (MessageId)
+		{
+			if (bClient)
+				Comp->MessageById_Request(Sender, MessageId, Buffer);
 			else if (bReliable)
-				Comp->Message_Notify(Sender, MessageStr, Buffer);
+				Comp->MessageById_Notify(Sender, MessageId, Buffer);
 			else
-				Comp->Unreliable_Notify(Sender, MessageStr, Buffer);
+				Comp->UnreliableById_Notify(Sender, MessageId, Buffer);
 		}
+		else if (bClient)
+			Comp->Message_Request(Sender, MessageName.ToString(), Buffer);
+		else if (bReliable)
+			Comp->Message_Notify(Sender, MessageName.ToString(), Buffer);
+		else
+			Comp->Unreliable_Notify(Sender, MessageName.ToString(), Buffer);
 	}
 }
 
@@ -369,7 +900,7 @@ void UGMPRpcProxy::Message_Request_Implementation(const UObject* InObject, const
 bool UGMPRpcProxy::Message_Request_Validate(const UObject* InObject, const FString& MessageStr, const TArray<uint8>& Buffer)
 {
 	FName MessageName(*MessageStr, FNAME_Find);
-	bool bValidate = MessageName.IsValid() && (Buffer.Num() <= MaxByteCount && UGMPRpcValidation::Find(this, MessageName));
+	bool bValidate = MessageName.IsValid() && (Buffer.Num() <= MaxByteCount && UGMPRpcValidation::Find(this, MessageName).IsValid());
 	return ensureAlwaysMsgf(bValidate, TEXT("Message_Request_Validate : %s with %s"), *MessageStr, *GetNameSafe(InObject));
 }
 
@@ -386,104 +917,494 @@ bool UGMPRpcProxy::CallLocalMessage(const UObject* InObject, const FString& Mess
 {
 	using namespace GMP;
 	FName MessageName(*MessageStr, FNAME_Find);
-	const TArray<FProperty*>* Find = MessageName.IsValid() ? UGMPRpcValidation::Find(this, MessageName) : nullptr;
-	if (!ensureWorldMsgf(InObject, Find, TEXT("rpc not registered for %s"), *MessageName.ToString()))
+	FGMPRpcLayoutPtr Find = MessageName.IsValid() ? UGMPRpcValidation::Find(this, MessageName) : FGMPRpcLayoutPtr();
+	if (!ensureWorldMsgf(InObject, Find.IsValid(), TEXT("rpc not registered for %s"), *MessageName.ToString()))
 		return false;
 
 	if (!ensureWorldMsgf(InObject, FMessageUtils::GetMessageHub()->IsAlive(MessageName), TEXT("no listener for %s"), *MessageStr))
 		return false;
 
-	return LocalBoardcastMessage(MessageStr, *Find, InObject, Buffer);
+	return DispatchMessage(InObject, MessageName, FGMPNetMessageId(), Find, Buffer);
 }
 
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable : 4750)  // warning C4750: function with _alloca() inlined into a loop
-#endif
-bool UGMPRpcProxy::LocalBoardcastMessage(const FString& MessageStr, const TArray<FProperty*>& Props, const UObject* Sender, const TArray<uint8>& Buffer)
+bool UGMPRpcProxy::CallLocalMessage(const UObject* InObject, const FString& MessageStr, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
+{
+	return MessageId ? CallLocalMessage(InObject, MessageId, Buffer) : CallLocalMessage(InObject, MessageStr, Buffer);
+}
+
+bool UGMPRpcProxy::CallLocalMessage(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
 {
 	using namespace GMP;
-	bool bSucc = true;
-	GMP::FTypedAddresses Params;
-	Params.Empty(Props.Num());
-	auto PackageMap = UGMPBPLib::GetPackageMap(CastChecked<APlayerController>(GetOwner()));
+	auto Find = FindIncomingId(MessageId);
+	if (!ensureWorldMsgf(InObject, Find, TEXT("rpc not registered for id %u"), MessageId.Index))
+		return false;
+
+	if (!ensureWorldMsgf(InObject, FMessageUtils::GetMessageHub()->IsAlive(Find->MessageName), TEXT("no listener for %s"), *Find->MessageName.ToString()))
+		return false;
+
+	return DispatchMessage(InObject, Find->MessageName, MessageId, Find->Layout, Buffer);
+}
 
-	struct FFrameOnScope
+//////////////////////////////////////////////////////////////////////////
+namespace GMP
+{
+namespace RpcProxy
+{
+	// proxies holding deferred requests, drained in turn from one budget per frame
+	static TArray<TWeakObjectPtr<UGMPRpcProxy>> DeferredProxies;
+	static int32 DeferredCursor = 0;
+	static uint64 DeferredFrame = 0;
+
+	// higher priority first, then arrival order
+	struct FDeferredPredicate
 	{
-		FFrameOnScope(const TArray<FProperty*>& Props)
+		template<typename T>
+		bool operator()(const T& Lhs, const T& Rhs) const
 		{
-			for (auto Prop : Props)
-			{
-				LocalTotalSize += Prop->ElementSize;
-			}
-			Locals = (uint8*)FMemory_Alloca(LocalTotalSize);
+			return Lhs.Priority != Rhs.Priority ? Lhs.Priority > Rhs.Priority : int32(Lhs.Order - Rhs.Order) < 0;
 		}
+	};
+}  // namespace RpcProxy
+}  // namespace GMP
 
-		uint8* Alloca(FProperty* InProp)
+// one request per proxy each step, resuming next frame where the budget ran out
+struct FGMPRpcDeferredRunner : public GMP::TGMPFrameTickBase<FGMPRpcDeferredRunner>
+{
+	FGMPRpcDeferredRunner(double InMaxDuration)
+		: GMP::TGMPFrameTickBase<FGMPRpcDeferredRunner>(InMaxDuration)
+	{
+	}
+	bool Step()
+	{
+		using namespace GMP::RpcProxy;
+		while (DeferredProxies.Num() > 0)
 		{
-			auto Ret = Locals;
-			Locals += InProp->ElementSize;
-			return Ret;
+			if (DeferredCursor >= DeferredProxies.Num())
+				DeferredCursor = 0;
+			UGMPRpcProxy* Proxy = DeferredProxies[DeferredCursor].Get();
+			if (Proxy && Proxy->DispatchDeferredMessage())
+			{
+				++DeferredCursor;
+				return true;
+			}
+			DeferredProxies.RemoveAtSwap(DeferredCursor);
+			if (Proxy)
+				Proxy->UpdateTickEnabled();
+			return DeferredProxies.Num() > 0;
 		}
+		return false;
+	}
+};
 
-		int32 LocalTotalSize = 0;
-		uint8* Locals = nullptr;
-	};
+void UGMPRpcProxy::SetMessageRatePolicy(FName MessageName, float TokensPerSecond, float Burst, int32 Priority)
+{
+	GMP::RpcProxy::RatePolicies.Add(MessageName, GMP::RpcProxy::FRatePolicy{FMath::Max(0.f, TokensPerSecond), FMath::Max(1.f, Burst), Priority});
+}
 
-#if defined(GMP_USING_SINGLE_ELEMENT_ALLOCATION)
-#define AllocaByProp(Prop, Scope) (uint8*)FMemory_Alloca(Prop->ElementSize)
-#else
-#define AllocaByProp(Prop, Scope) Scope.Alloca(Prop)
-#endif
+bool UGMPRpcProxy::IsRateLimited() const
+{
+	if (GetNetMode() == NM_Client)
+		return false;
+	auto PC = Cast<APlayerController>(GetOwner());
+	return PC && !PC->IsLocalController();
+}
 
-#if 1
-	FGMPNetBitReader Reader{PackageMap, const_cast<uint8*>(Buffer.GetData()), Buffer.Num() * 8};
-	FFrameOnScope Scope(Props);
-	int Index = 0;
-	for (; Index < Props.Num();)
+bool UGMPRpcProxy::DispatchMessage(const UObject* InObject, FName MessageName, FGMPNetMessageId MessageId, const FGMPRpcLayoutPtr& Layout, const TArray<uint8>& Buffer)
+{
+	using namespace GMP;
+	if (FRpcJournal::IsEnabled())
+		FRpcJournal::Record(FRpcJournal::Incoming, GetUniqueID(), MessageName, MessageId.Index, Buffer);
+
+	const auto Policy = RpcProxy::GetRatePolicy(MessageName);
+	if (Policy.TokensPerSecond <= 0.f || !IsRateLimited())
+		return LocalBoardcastMessage(MessageName, *Layout, InObject, Buffer);
+
+	const double Now = FPlatformTime::Seconds();
+	auto Find = TokenBuckets.Find(MessageName);
+	auto& Bucket = Find ? *Find : TokenBuckets.Add(MessageName, FTokenBucket{Policy.Burst, Now, 0});
+	Bucket.Tokens = FMath::Min(Policy.Burst, Bucket.Tokens + float((Now - Bucket.LastTime) * Policy.TokensPerSecond));
+	Bucket.LastTime = Now;
+
+	// keep the order of one key once some of its requests are waiting
+	if (Bucket.DeferredNum == 0 && Bucket.Tokens >= 1.f)
 	{
-		auto* Prop = Props[Index++];
-		uint8* Locals = AllocaByProp(Prop, Scope);
-		Prop->InitializeValue_InContainer(Locals);
-		Add_GetRef(Params).SetAddr(Locals, Prop);
+		Bucket.Tokens -= 1.f;
+		return LocalBoardcastMessage(MessageName, *Layout, InObject, Buffer);
+	}
 
-		if (!UGMPBPLib::NetSerializeProperty(Reader, Prop, Locals, PackageMap))
-		{
-			bSucc = false;
-			break;
-		}
+	++RpcProxy::RateStats.Limited;
+	if (DeferredMessages.Num() >= RpcProxy::DeferredQueueSize)
+	{
+		++DroppedMessageNum;
+		++RpcProxy::RateStats.Dropped;
+		GMP_WARNING(TEXT("rpc request dropped by rate limit : %s"), *MessageName.ToString());
+		return false;
 	}
 
-	if (bSucc)
+	++Bucket.DeferredNum;
+	++DeferredMessageNum;
+	++RpcProxy::RateStats.Deferred;
+	if (DeferredMessages.Num() == 0)
+		RpcProxy::DeferredProxies.Add(this);
+	DeferredMessages.HeapPush(FDeferredMessage{InObject, MessageName, Layout, Buffer, Policy.Priority, NextDeferredOrder++}, RpcProxy::FDeferredPredicate());
+	RpcProxy::RateStats.PeakQueued = FMath::Max(RpcProxy::RateStats.PeakQueued, DeferredMessages.Num());
+	UpdateTickEnabled();
+	return true;
+}
+
+bool UGMPRpcProxy::DispatchDeferredMessage()
+{
+	using namespace GMP;
+	if (DeferredMessages.Num() == 0)
+		return false;
+
+	FDeferredMessage Msg;
+	DeferredMessages.HeapPop(Msg, RpcProxy::FDeferredPredicate(), false);
+	if (auto Bucket = TokenBuckets.Find(Msg.MessageName))
+		--Bucket->DeferredNum;
+
+	++RpcProxy::RateStats.Dispatched;
+	if (FMessageUtils::GetMessageHub()->IsAlive(Msg.MessageName))
+		LocalBoardcastMessage(Msg.MessageName, *Msg.Layout, Msg.Obj.Get(), Msg.Buffer);
+	return DeferredMessages.Num() > 0;
+}
+
+void UGMPRpcProxy::UpdateTickEnabled()
+{
+	SetComponentTickEnabled(OutgoingFragments.Num() > 0 || DeferredMessages.Num() > 0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+FGMPNetMessageId UGMPRpcProxy::ResolveOutgoingId(FName MessageName, bool bClient, bool bReliable)
+{
+	using namespace GMP;
+	if (!RpcProxy::bUseMessageIds)
+		return FGMPNetMessageId();
+
+	if (auto Find = OutgoingMessageIds.Find(MessageName))
 	{
-		FMessageUtils::GetMessageHub()->ScriptNotifyMessage(MessageStr, Params, Sender ? Sender : GetWorld());
+		// reliable rpcs are ordered behind the definition, unreliable ones have to wait for the ack
+		return (bReliable || AckedMessageIds[*Find - 1]) ? FGMPNetMessageId(*Find) : FGMPNetMessageId();
 	}
 
-	for (--Index; Index >= 0; --Index)
+	if ((uint32)OutgoingMessageIds.Num() >= RpcProxy::MaxMessageIds)
+		return FGMPNetMessageId();
+
+	FGMPNetMessageId MessageId(OutgoingMessageIds.Num() + 1);
+	OutgoingMessageIds.Add(MessageName, MessageId.Index);
+	AckedMessageIds.Add(false);
+	if (bClient)
+		MessageId_Define_Request(MessageId, MessageName.ToString());
+	else
+		MessageId_Define_Notify(MessageId, MessageName.ToString());
+	return bReliable ? MessageId : FGMPNetMessageId();
+}
+
+const UGMPRpcProxy::FIncomingMessageId* UGMPRpcProxy::FindIncomingId(FGMPNetMessageId MessageId)
+{
+	const int32 Index = (int32)MessageId.Index - 1;
+	if (!IncomingMessageIds.IsValidIndex(Index))
+		return nullptr;
+
+	auto& Entry = IncomingMessageIds[Index];
+	if (!Entry.Layout.IsValid())
 	{
-		Props[Index]->DestroyValue_InContainer(Params[Index].ToAddr());
+		Entry.Layout = UGMPRpcValidation::Find(this, Entry.MessageName);
+		if (!Entry.Layout.IsValid())
+			return nullptr;
 	}
+	return &Entry;
+}
 
-#else
+bool UGMPRpcProxy::AddIncomingId(FGMPNetMessageId MessageId, const FString& MessageStr)
+{
+	// definitions are reliable and assigned in order, so each one extends the table by exactly one
+	if (!ensureWorldMsgf(this, MessageId.Index == (uint32)IncomingMessageIds.Num() + 1, TEXT("unexpected message id %u for %s"), MessageId.Index, *MessageStr))
+		return false;
+
+	IncomingMessageIds.Add(FIncomingMessageId{FName(*MessageStr), nullptr});
+	return true;
+}
 
-	for (auto Prop : Props)
+void UGMPRpcProxy::OnMessageIdAcked(FGMPNetMessageId MessageId)
+{
+	if (ensure(MessageId && MessageId.Index <= (uint32)AckedMessageIds.Num()))
+		AckedMessageIds[MessageId.Index - 1] = true;
+}
+
+bool UGMPRpcProxy::MessageId_Define_Request_Validate(FGMPNetMessageId MessageId, const FString& MessageStr)
+{
+	using namespace GMP;
+	FName MessageName(*MessageStr, FNAME_Find);
+	bool bValidate = MessageId.Index <= RpcProxy::MaxMessageIds && MessageId.Index == (uint32)IncomingMessageIds.Num() + 1 && MessageName.IsValid() && UGMPRpcValidation::Find(this, MessageName).IsValid();
+	return ensureAlwaysMsgf(bValidate, TEXT("MessageId_Define_Request_Validate : %u with %s"), MessageId.Index, *MessageStr);
+}
+
+void UGMPRpcProxy::MessageId_Define_Request_Implementation(FGMPNetMessageId MessageId, const FString& MessageStr)
+{
+	if (AddIncomingId(MessageId, MessageStr))
+		MessageId_Ack_Notify(MessageId);
+}
+
+void UGMPRpcProxy::MessageId_Define_Notify_Implementation(FGMPNetMessageId MessageId, const FString& MessageStr)
+{
+	if (AddIncomingId(MessageId, MessageStr))
+		MessageId_Ack_Request(MessageId);
+}
+
+bool UGMPRpcProxy::MessageId_Ack_Request_Validate(FGMPNetMessageId MessageId)
+{
+	return ensureAlways(MessageId && MessageId.Index <= (uint32)AckedMessageIds.Num());
+}
+
+void UGMPRpcProxy::MessageId_Ack_Request_Implementation(FGMPNetMessageId MessageId)
+{
+	OnMessageIdAcked(MessageId);
+}
+
+void UGMPRpcProxy::MessageId_Ack_Notify_Implementation(FGMPNetMessageId MessageId)
+{
+	OnMessageIdAcked(MessageId);
+}
+
+bool UGMPRpcProxy::MessageById_Request_Validate(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
+{
+	bool bValidate = Buffer.Num() <= MaxByteCount && IncomingMessageIds.IsValidIndex((int32)MessageId.Index - 1);
+	return ensureAlwaysMsgf(bValidate, TEXT("MessageById_Request_Validate : %u with %s"), MessageId.Index, *GetNameSafe(InObject));
+}
+
+void UGMPRpcProxy::MessageById_Request_Implementation(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
+{
+	CallLocalMessage(InObject, MessageId, Buffer);
+}
+
+void UGMPRpcProxy::MessageById_Notify_Implementation(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
+{
+	CallLocalMessage(InObject, MessageId, Buffer);
+}
+
+void UGMPRpcProxy::UnreliableById_Notify_Implementation(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer)
+{
+	CallLocalMessage(InObject, MessageId, Buffer);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void UGMPRpcProxy::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	SendFragments(GetNetMode() != NM_DedicatedServer);
+
+	// the first proxy ticking this frame drains the deferred requests of all of them
+	if (DeferredMessages.Num() > 0 && GMP::RpcProxy::DeferredFrame != GFrameCounter)
 	{
-		uint8* Locals = AllocaByProp(Prop, Scope);
-		Prop->InitializeValue_InContainer(Locals);
-		Add_GetRef(Params).SetAddr(Locals, Prop);
-		Locals = Locals + Prop->ElementSize;
+		GMP::RpcProxy::DeferredFrame = GFrameCounter;
+		FGMPRpcDeferredRunner Runner(GMP::RpcProxy::DeferredBudgetMs * 0.001);
+		Runner.TickDelta(DeltaTime);
 	}
+	UpdateTickEnabled();
+}
+
+void UGMPRpcProxy::QueueFragments(const UObject* Sender, FName MessageName, FGMPNetMessageId MessageId, TArray<uint8>&& Buffer)
+{
+	// the receiver rejects what it can not reassemble, a server would kick the client for it
+	const int64 MaxBytes = FMath::Min<int64>(int64(MAX_uint16) * MaxByteCount, int64(GMP::RpcProxy::ReassemblyMaxKB) * 1024);
+	if (!ensureWorldMsgf(this, Buffer.Num() <= MaxBytes, TEXT("rpc message too large : %s %d bytes"), *MessageName.ToString(), Buffer.Num()))
+		return;
+
+	OutgoingFragments.Add(FOutgoingMessage{const_cast<UObject*>(Sender), MessageName, MessageId, MoveTemp(Buffer), ++NextFragmentSequence, 0});
+	SendFragments(GetNetMode() != NM_DedicatedServer);
+}
+
+void UGMPRpcProxy::SendFragments(bool bClient)
+{
+	using namespace GMP;
+	int32 Budget = RpcProxy::FragmentBytesPerTick > 0 ? RpcProxy::FragmentBytesPerTick : MAX_int32;
+	while (OutgoingFragments.Num() > 0 && Budget > 0 && !RpcProxy::IsReliableBufferFull(this))
+	{
+		auto& Msg = OutgoingFragments[0];
+		FGMPRpcFragment Fragment;
+		Fragment.Sequence = Msg.Sequence;
+		Fragment.FragmentIndex = (uint16)(Msg.Offset / MaxByteCount);
+		Fragment.FragmentCount = (uint16)FMath::Max(1, FMath::DivideAndRoundUp(Msg.Buffer.Num(), MaxByteCount));
+		if (Msg.Offset == 0)
+		{
+			Fragment.Obj = Msg.Obj.Get();
+			Fragment.TotalBytes = Msg.Buffer.Num();
+			if (Msg.MessageId)
+				Fragment.KeyId = Msg.MessageId;
+			else
+				Fragment.Key = Msg.MessageName.ToString();
+		}
+
+		const int32 Size = FMath::Min(MaxByteCount, Msg.Buffer.Num() - Msg.Offset);
+		Fragment.Buff.Append(Msg.Buffer.GetData() + Msg.Offset, Size);
+		Msg.Offset += Size;
+		Budget -= FMath::Max(Size, 1);
+		if (Msg.Offset >= Msg.Buffer.Num())
+			OutgoingFragments.RemoveAt(0, 1, false);
 
-	if (!UGMPBPLib::ArchiveToMessage(Buffer, Params, Props, PackageMap))
+		if (bClient)
+			Fragment_Request(Fragment);
+		else
+			Fragment_Notify(Fragment);
+	}
+	UpdateTickEnabled();
+}
+
+bool UGMPRpcProxy::IsValidFragment(const FGMPRpcFragment& Fragment)
+{
+	using namespace GMP;
+	if (Fragment.Buff.Num() > MaxByteCount || Fragment.FragmentIndex >= Fragment.FragmentCount)
 		return false;
 
-	FMessageUtils::GetMessageHub()->ScriptNotifyMessage(MessageStr, Params, Sender ? Sender : GetWorld());
-	for (auto i = 0; i < Props.Num(); ++i)
+	if (Fragment.FragmentIndex == 0)
 	{
-		Props[i]->DestroyValue_InContainer(Params[i].ToAddr());
+		const int64 Capacity = int64(RpcProxy::ReassemblyMaxKB) * 1024;
+		const bool bSingle = Fragment.FragmentCount == 1;
+		if (!(Fragment.FragmentCount == FMath::Max<int64>(1, (int64(Fragment.TotalBytes) + MaxByteCount - 1) / MaxByteCount)
+			  && (bSingle ? uint32(Fragment.Buff.Num()) == Fragment.TotalBytes : (!IncomingFragments.Contains(Fragment.Sequence) && IncomingFragmentBytes + Fragment.TotalBytes <= Capacity))))
+			return false;
+
+		// unregistered messages are rejected before any reassembly memory is reserved
+		if (Fragment.KeyId)
+			return !!FindIncomingId(Fragment.KeyId);
+		const FName MessageName(*Fragment.Key, FNAME_Find);
+		return !MessageName.IsNone() && UGMPRpcValidation::Find(this, MessageName).IsValid();
 	}
 
+	// fragments are reliable and never interleaved within one message
+	auto Find = IncomingFragments.Find(Fragment.Sequence);
+	return Find && Find->ReceivedCount == Fragment.FragmentIndex && Find->FragmentCount == Fragment.FragmentCount && uint32(Find->Buffer.Num() + Fragment.Buff.Num()) <= Find->TotalBytes;
+}
+
+void UGMPRpcProxy::ReceiveFragment(const FGMPRpcFragment& Fragment)
+{
+	if (!ensureWorldMsgf(this, IsValidFragment(Fragment), TEXT("invalid rpc fragment %u [%d/%d]"), Fragment.Sequence, Fragment.FragmentIndex, Fragment.FragmentCount))
+		return;
+
+	if (Fragment.FragmentCount == 1)
+	{
+		CallLocalMessage(Fragment.Obj, Fragment.Key, Fragment.KeyId, Fragment.Buff);
+		return;
+	}
+
+	if (Fragment.FragmentIndex == 0)
+	{
+		auto& NewMsg = IncomingFragments.Add(Fragment.Sequence, FIncomingMessage{Fragment.Obj, Fragment.Key, Fragment.KeyId, {}, Fragment.TotalBytes, Fragment.FragmentCount, 0});
+		NewMsg.Buffer.Reserve(Fragment.TotalBytes);
+		IncomingFragmentBytes += Fragment.TotalBytes;
+	}
+
+	auto& Msg = IncomingFragments.FindChecked(Fragment.Sequence);
+	Msg.Buffer.Append(Fragment.Buff);
+	if (++Msg.ReceivedCount < Msg.FragmentCount)
+		return;
+
+	FIncomingMessage Done;
+	IncomingFragments.RemoveAndCopyValue(Fragment.Sequence, Done);
+	IncomingFragmentBytes -= Done.TotalBytes;
+	if (ensureWorldMsgf(this, uint32(Done.Buffer.Num()) == Done.TotalBytes, TEXT("rpc fragment %u size mismatch"), Fragment.Sequence))
+		CallLocalMessage(Done.Obj.Get(), Done.Key, Done.KeyId, Done.Buffer);
+}
+
+bool UGMPRpcProxy::Fragment_Request_Validate(const FGMPRpcFragment& Fragment)
+{
+	return ensureAlwaysMsgf(IsValidFragment(Fragment), TEXT("Fragment_Request_Validate : %u [%d/%d]"), Fragment.Sequence, Fragment.FragmentIndex, Fragment.FragmentCount);
+}
+
+void UGMPRpcProxy::Fragment_Request_Implementation(const FGMPRpcFragment& Fragment)
+{
+	ReceiveFragment(Fragment);
+}
+
+void UGMPRpcProxy::Fragment_Notify_Implementation(const FGMPRpcFragment& Fragment)
+{
+	ReceiveFragment(Fragment);
+}
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4750)  // warning C4750: function with _alloca() inlined into a loop
 #endif
+bool UGMPRpcProxy::LocalBoardcastMessage(FName MessageName, const FGMPRpcLayout& Layout, const UObject* Sender, const TArray<uint8>& Buffer)
+{
+	auto PackageMap = UGMPBPLib::GetPackageMap(CastChecked<APlayerController>(GetOwner()));
+	return DecodeMessage(MessageName, Layout, PackageMap, Sender ? Sender : GetWorld(), Buffer);
+}
+
+bool UGMPRpcProxy::DecodeMessage(FName MessageName, const FGMPRpcLayout& Layout, UPackageMap* PackageMap, const UObject* Sender, const TArray<uint8>& Buffer)
+{
+	using namespace GMP;
+	bool bSucc = true;
+	const int32 Num = Layout.Props.Num();
+
+	// one frame for all arguments, zero constructible ones need no further init
+	uint8* Frame = Align((uint8*)FMemory_Alloca(Layout.TotalSize + Layout.Alignment), Layout.Alignment);
+	FMemory::Memzero(Frame, Layout.TotalSize);
+
+	GMP::FTypedAddresses Params;
+	Params.Reserve(Num);
+	FGMPNetBitReader Reader{PackageMap, const_cast<uint8*>(Buffer.GetData()), Buffer.Num() * 8};
+
+	// whole pack of numerics in one read, nothing to construct or destroy
+	if (Layout.RawPackBytes > 0 && !Reader.IsByteSwapping())
+	{
+		uint8* Packed = (uint8*)FMemory_Alloca(Layout.RawPackBytes);
+		Reader.SerializeBits(Packed, Layout.RawPackBytes * 8);
+		if (!ensureWorld(PackageMap, !Reader.IsError()))
+			return false;
+
+		for (int32 Idx = 0; Idx < Num; ++Idx)
+		{
+			FProperty* Prop = Layout.Props[Idx];
+			uint8* Locals = Frame + Layout.Offsets[Idx];
+			FMemory::Memcpy(Locals, Packed, Prop->ElementSize);
+			Packed += Prop->ElementSize;
+			Add_GetRef(Params).SetAddr(Locals, Prop);
+		}
+		FMessageUtils::GetMessageHub()->ScriptNotifyMessage(MessageName, Params, Sender);
+		return true;
+	}
+
+	int32 Index = 0;
+	for (; Index < Num;)
+	{
+		FProperty* Prop = Layout.Props[Index];
+		const uint8 PropFlags = Layout.Flags[Index];
+		uint8* Locals = Frame + Layout.Offsets[Index++];
+		if (!(PropFlags & FGMPRpcLayout::ZeroInit))
+			Prop->InitializeValue_InContainer(Locals);
+		Add_GetRef(Params).SetAddr(Locals, Prop);
+
+		if (PropFlags & FGMPRpcLayout::RawBytes)
+		{
+			Reader.ByteOrderSerialize(Locals, Prop->ElementSize);
+			if (!ensureWorld(PackageMap, !Reader.IsError()))
+			{
+				bSucc = false;
+				break;
+			}
+		}
+		else if (!UGMPBPLib::NetSerializeProperty(Reader, Prop, Locals, PackageMap))
+		{
+			bSucc = false;
+			break;
+		}
+	}
+
+	if (bSucc)
+	{
+		FMessageUtils::GetMessageHub()->ScriptNotifyMessage(MessageName, Params, Sender);
+	}
+
+	if (Layout.bNeedsDestroy)
+	{
+		for (--Index; Index >= 0; --Index)
+		{
+			if (!(Layout.Flags[Index] & FGMPRpcLayout::NoDestructor))
+				Layout.Props[Index]->DestroyValue_InContainer(Params[Index].ToAddr());
+		}
+	}
 	return bSucc;
 }
 #ifdef _MSC_VER
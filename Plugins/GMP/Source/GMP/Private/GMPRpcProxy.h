@@ -15,6 +15,39 @@
 
 class APlayerController;
 
+// index of a message key in the dictionary of one proxy, 0 means the key is sent by name
+USTRUCT()
+struct GMP_API FGMPNetMessageId
+{
+	GENERATED_BODY()
+public:
+	FGMPNetMessageId() = default;
+	explicit FGMPNetMessageId(uint32 InIndex)
+		: Index(InIndex)
+	{
+	}
+	explicit operator bool() const { return Index != 0; }
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+	{
+		Ar.SerializeIntPacked(Index);
+		bOutSuccess = true;
+		return true;
+	}
+
+	UPROPERTY()
+	uint32 Index = 0;
+};
+
+template<>
+struct TStructOpsTypeTraits<FGMPNetMessageId> : public TStructOpsTypeTraitsBase2<FGMPNetMessageId>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
 USTRUCT()
 struct GMP_API FGMPRpcBatchData
 {
@@ -28,6 +61,13 @@ public:
 		, bFunction(bFunc)
 	{
 	}
+	FGMPRpcBatchData(UObject* InObj, FGMPNetMessageId InKeyId, TArray<uint8>&& InBuff)
+		: Obj(InObj)
+		, KeyId(InKeyId)
+		, Buff(MoveTemp(InBuff))
+		, bFunction(false)
+	{
+	}
 
 	UPROPERTY()
 	UObject* Obj;
@@ -35,6 +75,10 @@ public:
 	UPROPERTY()
 	FString Key;
 
+	// replaces Key when set
+	UPROPERTY()
+	FGMPNetMessageId KeyId;
+
 	UPROPERTY()
 	TArray<uint8> Buff;
 
@@ -42,6 +86,57 @@ public:
 	bool bFunction;
 };
 
+// wire format of a batch, objects and keys are sent once per batch and the payloads may be compressed as one stream
+USTRUCT()
+struct GMP_API FGMPRpcBatch
+{
+	GENERATED_BODY()
+public:
+	TArray<FGMPRpcBatchData> Entries;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FGMPRpcBatch> : public TStructOpsTypeTraitsBase2<FGMPRpcBatch>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+// one slice of a message larger than UGMPRpcProxy::MaxByteCount, the header fields are only set on the first slice
+USTRUCT()
+struct GMP_API FGMPRpcFragment
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	uint32 Sequence = 0;
+
+	UPROPERTY()
+	uint16 FragmentIndex = 0;
+
+	UPROPERTY()
+	uint16 FragmentCount = 0;
+
+	UPROPERTY()
+	UObject* Obj = nullptr;
+
+	UPROPERTY()
+	FString Key;
+
+	UPROPERTY()
+	FGMPNetMessageId KeyId;
+
+	UPROPERTY()
+	uint32 TotalBytes = 0;
+
+	UPROPERTY()
+	TArray<uint8> Buff;
+};
+
 UCLASS(Transient)
 class UGMPPropertiesContainer final : public UStruct
 {
@@ -55,15 +150,38 @@ protected:
 	TMap<FProperty*, FName> FastLookups;
 };
 
+// receive frame of one rpc message, computed once when its processor is registered
+struct GMP_API FGMPRpcLayout
+{
+	explicit FGMPRpcLayout(const TArray<FProperty*>& InProps);
+
+	enum EPropFlags : uint8
+	{
+		ZeroInit = 1 << 0,
+		NoDestructor = 1 << 1,
+		RawBytes = 1 << 2,  // numeric, NetSerializeItem writes the value as is
+	};
+
+	TArray<FProperty*> Props;
+	TArray<int32, TInlineAllocator<8>> Offsets;
+	TArray<uint8, TInlineAllocator<8>> Flags;
+	int32 TotalSize = 0;
+	int32 Alignment = 1;
+	// set when every argument is raw, senders then write the whole pack as one block (see Serializer::NetSerializeBulk)
+	int32 RawPackBytes = 0;
+	bool bNeedsDestroy = false;
+};
+using FGMPRpcLayoutPtr = TSharedPtr<const FGMPRpcLayout>;
+
 UCLASS(Transient)
 class UGMPRpcValidation final : public UObject
 {
 	GENERATED_BODY()
 public:
 	static bool VerifyRpc(const UObject* Obj, const FName& MessageKey, const TArray<FProperty*>& Props);
-	static const TArray<FProperty*>* Find(const UObject* Obj, const FName& MessageKey);
+	static FGMPRpcLayoutPtr Find(const UObject* Obj, const FName& MessageKey);
 
-	TMap<FName, TArray<FProperty*>> RPCProcessors;
+	TMap<FName, FGMPRpcLayoutPtr> RPCProcessors;
 
 	static int32 GetNextPlayerSequence(const APlayerController& PC);
 	int32 PlayerSequenceID = 0;
@@ -86,11 +204,16 @@ public:
 protected:
 	virtual void BeginPlay() override;
 	virtual void InitializeComponent() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	//////////////////////////////////////////////////////////////////////////
 protected:
 	bool CallLocalMessage(const UObject* InObject, const FString& MessageStr, const TArray<uint8>& Buffer);
-	bool LocalBoardcastMessage(const FString& MessageStr, const TArray<FProperty*>& Props, const UObject* InObject, const TArray<uint8>& Buffer);
+	bool CallLocalMessage(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer);
+	bool LocalBoardcastMessage(FName MessageName, const FGMPRpcLayout& Layout, const UObject* InObject, const TArray<uint8>& Buffer);
+	static bool DecodeMessage(FName MessageName, const FGMPRpcLayout& Layout, UPackageMap* PackageMap, const UObject* Sender, const TArray<uint8>& Buffer);
+	friend class UGMPRpcJournalCommandlet;
 
 	UFUNCTION(Server, Reliable, WithValidation)
 	void Message_Request(const UObject* InObject, const FString& MessageStr, const TArray<uint8>& Buffer);
@@ -99,6 +222,80 @@ protected:
 	UFUNCTION(Client, unreliable)
 	void Unreliable_Notify(const UObject* InObject, const FString& MessageStr, const TArray<uint8>& Buffer);
 
+	//////////////////////////////////////////////////////////////////////////
+	// message key dictionary, built lazily by the sending side of each direction
+protected:
+	TMap<FName, uint32> OutgoingMessageIds;
+	TBitArray<> AckedMessageIds;
+
+	struct FIncomingMessageId
+	{
+		FName MessageName;
+		// resolved on first use, the processor table may not know the key yet when it is defined
+		FGMPRpcLayoutPtr Layout;
+	};
+	TArray<FIncomingMessageId> IncomingMessageIds;
+
+	FGMPNetMessageId ResolveOutgoingId(FName MessageName, bool bClient, bool bReliable);
+	const FIncomingMessageId* FindIncomingId(FGMPNetMessageId MessageId);
+	bool AddIncomingId(FGMPNetMessageId MessageId, const FString& MessageStr);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void MessageId_Define_Request(FGMPNetMessageId MessageId, const FString& MessageStr);
+	UFUNCTION(Client, Reliable)
+	void MessageId_Define_Notify(FGMPNetMessageId MessageId, const FString& MessageStr);
+	UFUNCTION(Server, Reliable, WithValidation)
+	void MessageId_Ack_Request(FGMPNetMessageId MessageId);
+	UFUNCTION(Client, Reliable)
+	void MessageId_Ack_Notify(FGMPNetMessageId MessageId);
+	void OnMessageIdAcked(FGMPNetMessageId MessageId);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void MessageById_Request(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer);
+	UFUNCTION(Client, Reliable)
+	void MessageById_Notify(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer);
+	UFUNCTION(Client, unreliable)
+	void UnreliableById_Notify(const UObject* InObject, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer);
+
+	//////////////////////////////////////////////////////////////////////////
+	// messages above MaxByteCount are split into reliable fragments, later messages queue behind them to keep the order
+protected:
+	struct FOutgoingMessage
+	{
+		TWeakObjectPtr<UObject> Obj;
+		FName MessageName;
+		FGMPNetMessageId MessageId;
+		TArray<uint8> Buffer;
+		uint32 Sequence;
+		int32 Offset;
+	};
+	TArray<FOutgoingMessage> OutgoingFragments;
+	uint32 NextFragmentSequence = 0;
+
+	struct FIncomingMessage
+	{
+		TWeakObjectPtr<UObject> Obj;
+		FString Key;
+		FGMPNetMessageId KeyId;
+		TArray<uint8> Buffer;
+		uint32 TotalBytes;
+		uint16 FragmentCount;
+		uint16 ReceivedCount;
+	};
+	TMap<uint32, FIncomingMessage> IncomingFragments;
+	int64 IncomingFragmentBytes = 0;
+
+	void QueueFragments(const UObject* Sender, FName MessageName, FGMPNetMessageId MessageId, TArray<uint8>&& Buffer);
+	void SendFragments(bool bClient);
+	bool IsValidFragment(const FGMPRpcFragment& Fragment);
+	void ReceiveFragment(const FGMPRpcFragment& Fragment);
+	bool CallLocalMessage(const UObject* InObject, const FString& MessageStr, FGMPNetMessageId MessageId, const TArray<uint8>& Buffer);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void Fragment_Request(const FGMPRpcFragment& Fragment);
+	UFUNCTION(Client, Reliable)
+	void Fragment_Notify(const FGMPRpcFragment& Fragment);
+
 	//////////////////////////////////////////////////////////////////////////
 protected:
 	void CallLocalFunction(UObject* InUserObject, FName InFunctionName, const TArray<uint8>& Buffer);
@@ -110,24 +307,78 @@ protected:
 protected:
 	void DispatchPendingProgress(const TArray<FGMPRpcBatchData>& Batcher);
 	UFUNCTION(Server, Reliable, WithValidation)
-	void Batch_Request(const TArray<FGMPRpcBatchData>& Batcher);
+	void Batch_Request(const FGMPRpcBatch& Batcher);
 	UFUNCTION(Client, Reliable)
-	void Batch_Notify(const TArray<FGMPRpcBatchData>& Batcher);
+	void Batch_Notify(const FGMPRpcBatch& Batcher);
+	UFUNCTION(Client, unreliable)
+	void Unreliable_Batch_Notify(const FGMPRpcBatch& Batcher);
 
 	UPROPERTY(Transient)
 	TArray<FGMPRpcBatchData> PendingRPCs;
 	int32 ScopedCnt = 0;
 
+	// auto batching outside of scopes, unreliable notifies get their own lane and are dropped as a whole
+	UPROPERTY(Transient)
+	TArray<FGMPRpcBatchData> PendingUnreliableRPCs;
+	int32 PendingReliableBytes = 0;
+	int32 PendingUnreliableBytes = 0;
+	bool bAutoBatchQueued = false;
+
+	bool WantsAutoBatch() const;
+	void AddPendingRPC(FGMPRpcBatchData&& Data, bool bReliable);
+	static void FlushAutoBatches(UWorld* InWorld);
+
 	void FlushPendingRPCs();
-	static int32 IncreaseBatchRef(UGMPRpcProxy* Proxy) { return Proxy ? ++Proxy->ScopedCnt : 0; }
-	static void DecreaseBatchRef(UGMPRpcProxy* Proxy)
-	{
-		if (Proxy && Proxy->ScopedCnt > 0 && --Proxy->ScopedCnt == 0)
-			Proxy->FlushPendingRPCs();
-	}
+	void SendPendingRPCs();
+	static int32 IncreaseBatchRef(UGMPRpcProxy* Proxy);
+	static void DecreaseBatchRef(UGMPRpcProxy* Proxy);
 	friend struct FGMPRpcBatchScope;
+
+	//////////////////////////////////////////////////////////////////////////
+	// requests from remote clients pass a token bucket per message key, excess ones wait in a priority queue drained under a frame budget
+protected:
+	struct FTokenBucket
+	{
+		float Tokens;
+		double LastTime;
+		int32 DeferredNum;
+	};
+	TMap<FName, FTokenBucket> TokenBuckets;
+
+	struct FDeferredMessage
+	{
+		TWeakObjectPtr<const UObject> Obj;
+		FName MessageName;
+		FGMPRpcLayoutPtr Layout;
+		TArray<uint8> Buffer;
+		int32 Priority;
+		uint32 Order;
+	};
+	TArray<FDeferredMessage> DeferredMessages;
+	uint32 NextDeferredOrder = 0;
+	int64 DroppedMessageNum = 0;
+	int64 DeferredMessageNum = 0;
+
+	bool IsRateLimited() const;
+	bool DispatchMessage(const UObject* InObject, FName MessageName, FGMPNetMessageId MessageId, const FGMPRpcLayoutPtr& Layout, const TArray<uint8>& Buffer);
+	bool DispatchDeferredMessage();
+	void UpdateTickEnabled();
+	friend struct FGMPRpcDeferredRunner;
+
+public:
+	// TokensPerSecond 0 disables limiting of that key, higher priorities leave the deferred queue first
+	static void SetMessageRatePolicy(FName MessageName, float TokensPerSecond, float Burst, int32 Priority = 0);
+	int64 GetDroppedMessageNum() const { return DroppedMessageNum; }
+	int64 GetDeferredMessageNum() const { return DeferredMessageNum; }
+
+	static UGMPRpcProxy* ResolveProxy(APlayerController* PC, const UObject* Context);
+
 public:
+	// proxies register themselves per player controller, lookups only fall back to a component scan on a miss
+	static UGMPRpcProxy* FindProxy(const APlayerController* PC);
+
 	static void CallMessageRemote(APlayerController* PC, const UObject* Sender, const FString& MessageStr, TArray<uint8>& Buffer, bool bReliable = true);
+	static void CallMessageRemote(APlayerController* PC, const UObject* Sender, FName MessageName, TArray<uint8>& Buffer, bool bReliable = true);
 	static bool CallFunctionRemote(APlayerController* PC, UObject* InUserObject, FName InFunctionName, TArray<uint8>& Buffer);
 };
 
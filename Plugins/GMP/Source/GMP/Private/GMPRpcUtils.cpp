@@ -24,9 +24,9 @@ const int32 FRpcMessageUtils::GetMaxBytes()
 	return UGMPRpcProxy::MaxByteCount;
 }
 
-void FRpcMessageUtils::PostRPCMsg(APlayerController* PC, UObject* Sender, const FString& MessageStr, TArray<uint8>& Buffer, bool bReliable)
+void FRpcMessageUtils::PostRPCMsg(APlayerController* PC, UObject* Sender, FName MessageName, TArray<uint8>& Buffer, bool bReliable)
 {
-	UGMPRpcProxy::CallMessageRemote(PC, Sender, MessageStr, Buffer, bReliable);
+	UGMPRpcProxy::CallMessageRemote(PC, Sender, MessageName, Buffer, bReliable);
 }
 
 APlayerController* FRpcMessageUtils::GetLocalPC(UObject* Obj)
@@ -46,6 +46,54 @@ bool FRpcMessageUtils::Z_VerifyRPC(APlayerController* PC, const UObject* Obj, co
 	return UGMPRpcValidation::VerifyRpc(WorldContext, MessageName, Props);
 }
 
+static bool PropertyNeedsPackageMap(FProperty* Prop)
+{
+	if (Prop->IsA<FSoftObjectProperty>())
+		return false;
+	if (Prop->IsA<FObjectPropertyBase>() || Prop->IsA<FInterfaceProperty>())
+		return true;
+	if (auto StructProp = CastField<FStructProperty>(Prop))
+	{
+		// custom serializers get the map and may use it
+		if (StructProp->Struct->StructFlags & STRUCT_NetSerializeNative)
+			return true;
+		for (TFieldIterator<FProperty> It(StructProp->Struct); It; ++It)
+		{
+			if (PropertyNeedsPackageMap(*It))
+				return true;
+		}
+		return false;
+	}
+	if (auto ArrProp = CastField<FArrayProperty>(Prop))
+		return PropertyNeedsPackageMap(ArrProp->Inner);
+	if (auto SetProp = CastField<FSetProperty>(Prop))
+		return PropertyNeedsPackageMap(SetProp->ElementProp);
+	if (auto MapProp = CastField<FMapProperty>(Prop))
+		return PropertyNeedsPackageMap(MapProp->KeyProp) || PropertyNeedsPackageMap(MapProp->ValueProp);
+	return false;
+}
+
+bool FRpcMessageUtils::NeedsPackageMap(const TArray<FProperty*>& Props)
+{
+	for (FProperty* Prop : Props)
+	{
+		if (!Prop || PropertyNeedsPackageMap(Prop))
+			return true;
+	}
+	return false;
+}
+
+void FRpcMessageUtils::GetPlayerControllers(UWorld* World, TArray<APlayerController*>& OutPCs)
+{
+	if (!World)
+		return;
+	for (auto It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (APlayerController* PC = It->Get())
+			OutPCs.Add(PC);
+	}
+}
+
 int32 FRpcMessageUtils::GetPlayerLocalSequence(const APlayerController& PC)
 {
 	return UGMPRpcValidation::GetNextPlayerSequence(PC);
@@ -59,7 +107,7 @@ FGMPRpcBatchScope::FGMPRpcBatchScope(UGMPRpcProxy* InProxy)
 }
 
 FGMPRpcBatchScope::FGMPRpcBatchScope(APlayerController* PC)
-	: FGMPRpcBatchScope(PC ? PC->FindComponentByClass<UGMPRpcProxy>() : (UGMPRpcProxy*)nullptr)
+	: FGMPRpcBatchScope(UGMPRpcProxy::FindProxy(PC))
 {
 #if WITH_EDITOR
 	VerifyFrameNumber = GFrameNumber;
@@ -2,11 +2,11 @@
 
 #include "GMPSignalsImpl.h"
 
-#include <algorithm>
+#include "Misc/CoreDelegates.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/UObjectGlobals.h"
 
-#if UE_4_23_OR_LATER
-#include "Containers/LockFreeList.h"
-#endif
+#include <atomic>
 
 FGMPKey FGMPKey::NextGMPKey()
 {
@@ -29,58 +29,151 @@ namespace GMP
 static TSet<FSigSource> GMPSigSources;
 #endif
 
+struct FRemovedSource
+{
+	FSigSource Source;
+	// captured on removal, the object is gone by the time the batch is purged
+	FWeakObjectPtr Handler;
+};
+
+#if GMP_SIGNALS_MULTI_THREAD_REMOVAL
+// object indices of the sources with mappings, set on the game thread and taken back without a lock when the object is deleted
+class FSourceIndexBits
+{
+public:
+	FSourceIndexBits()
+		: NumChunks(FMath::DivideAndRoundUp(FMath::Max(GUObjectArray.GetObjectArrayCapacity(), 1), ChunkSize))
+		, Chunks(new std::atomic<std::atomic<uint64>*>[NumChunks])
+	{
+		for (int32 Idx = 0; Idx < NumChunks; ++Idx)
+			Chunks[Idx].store(nullptr, std::memory_order_relaxed);
+	}
+	~FSourceIndexBits()
+	{
+		for (int32 Idx = 0; Idx < NumChunks; ++Idx)
+			delete[] Chunks[Idx].load(std::memory_order_relaxed);
+		delete[] Chunks;
+	}
+
+	void Set(int32 Index)
+	{
+		checkSlow(IsInGameThread());
+		if (Index < 0 || Index / ChunkSize >= NumChunks)
+			return;
+		auto& Chunk = Chunks[Index / ChunkSize];
+		auto Words = Chunk.load(std::memory_order_acquire);
+		if (!Words)
+		{
+			Words = new std::atomic<uint64>[ChunkSize / 64];
+			for (int32 Idx = 0; Idx < ChunkSize / 64; ++Idx)
+				Words[Idx].store(0, std::memory_order_relaxed);
+			Chunk.store(Words, std::memory_order_release);
+		}
+		Words[(Index % ChunkSize) / 64].fetch_or(1ull << (Index % 64), std::memory_order_relaxed);
+	}
+
+	// an index is only reused after its object was deleted, so clearing here never races a new source
+	bool TestAndClear(int32 Index)
+	{
+		if (Index < 0 || Index / ChunkSize >= NumChunks)
+			return true;
+		auto Words = Chunks[Index / ChunkSize].load(std::memory_order_acquire);
+		if (!Words)
+			return false;
+		const uint64 Bit = 1ull << (Index % 64);
+		return !!(Words[(Index % ChunkSize) / 64].fetch_and(~Bit, std::memory_order_relaxed) & Bit);
+	}
+
+private:
+	static constexpr int32 ChunkSize = 64 * 1024;
+	const int32 NumChunks;
+	std::atomic<std::atomic<uint64>*>* Chunks;
+};
+#endif
+
 struct FSignalUtils
 {
 	static void ShutdownSingal(FSignalStore* In)
 	{
 		In->SourceObjs.Reset();
 		In->HandlerObjs.Reset();
-		In->AnySrcSigKeys.Reset();
-		In->GetStorageMap().Reset();
+		In->AnySrcSigElms.Reset();
+		In->DirtyBuckets.Reset();
+		In->bAnySrcDirty = false;
+		In->SigElmMap.Reset();
+		In->SigElmSlots.Reset();
+		In->bSlotsUnsorted = false;
+		In->StaleSlots = 0;
+		In->PendingKills.Reset();
+		In->FiringDepth = 0;
+		FGMPSlabPool::ReleaseUnused();
 	}
 
-	static void StaticOnObjectRemoved(FSignalStore* In, FSigSource InObj)
+	static void StaticOnObjectRemoved(FSignalStore* In, FSigSource InObj) { StaticOnObjectRemoved(In, InObj, FWeakObjectPtr(InObj.TryGetUObject())); }
+	static void StaticOnObjectsRemoved(FSignalStore* In, TArrayView<const FRemovedSource> Sources);
+
+	static void StaticOnObjectRemoved(FSignalStore* In, FSigSource InObj, const FWeakObjectPtr& InHandler)
 	{
 		checkSlow(IsInGameThread());
 
 		// Sources
 		FSignalStore::FSigElmPtrSet SigElms;
-		In->SourceObjs.RemoveAndCopyValue(InObj, SigElms);
-
-		// Handlers
-		if (auto Obj = InObj.TryGetUObject())
+		if (InObj.SigOrObj())
 		{
-			FSignalStore::FSigElmPtrSet Handlers;
-			In->HandlerObjs.RemoveAndCopyValue(Obj, Handlers);
-			SigElms.Append(Handlers);
+			if (In->IsFiring())
+			{
+				if (auto Bucket = In->SourceObjs.Find(InObj))
+				{
+					for (auto& SigElm : *Bucket)
+					{
+						if (SigElm)
+							SigElms.Add(SigElm);
+						SigElm = nullptr;
+					}
+					Bucket->StaleNum = Bucket->Num();
+					In->DirtyBuckets.Add(InObj);
+				}
+			}
+			else
+			{
+				FSignalStore::FSigElmBucket Bucket;
+				if (In->SourceObjs.RemoveAndCopyValue(InObj, Bucket))
+				{
+					for (auto SigElm : Bucket)
+					{
+						if (SigElm)
+							SigElms.Add(SigElm);
+					}
+				}
+			}
 		}
 
-		// Storage
+		// Handlers
+		FSignalStore::FSigElmPtrSet Handlers;
+		if (!InHandler.IsExplicitlyNull())
+			In->HandlerObjs.RemoveAndCopyValue(InHandler, Handlers);
+
 		for (auto SigElm : SigElms)
-		{
-			auto Key = SigElm->GetGMPKey();
+			In->UnlinkHandler(SigElm);
+		for (auto SigElm : Handlers)
+			In->UnlinkSource(SigElm);
+		SigElms.Append(Handlers);
 
-			// if (SigElm->GetHandler().IsExplicitlyNull())
-			In->AnySrcSigKeys.Remove(Key);
-			In->GetStorageMap().Remove(Key);
-		}
+		// Storage
+		for (auto SigElm : SigElms)
+			In->RemoveSlot(SigElm);
 	}
 
 	template<bool bAllowDuplicate>
 	static void RemoveSigElm(FSignalStore* In, FGMPKey Key)
 	{
-		In->AnySrcSigKeys.Remove(Key);
-
 		// Storage
-		decltype(In->GetStorageMap().FindRef(Key)) SigElm;
-		if (!In->GetStorageMap().RemoveAndCopyValue(Key, SigElm))
+		FSigElm* SigElm = In->SigElmMap.FindRef(Key);
+		if (!SigElm)
 			return;
 
 		// Sources
-		if (auto Find = In->SourceObjs.Find(SigElm->GetSource()))
-		{
-			Find->Remove(SigElm.Get());
-		}
+		In->UnlinkSource(SigElm);
 
 		// Handlers
 		auto Handler = SigElm->GetHandler();
@@ -88,7 +181,7 @@ struct FSignalUtils
 		{
 			if (auto Find = In->HandlerObjs.Find(Handler))
 			{
-				Find->Remove(SigElm.Get());
+				Find->Remove(SigElm);
 			}
 		}
 		else
@@ -96,11 +189,14 @@ struct FSignalUtils
 			// no need to seach any more
 			In->HandlerObjs.Remove(Handler);
 		}
+
+		In->RemoveSlot(SigElm);
 	}
 
 	template<bool bAllowDuplicate>
 	static void RemoveExactly(FSignalStore* In, const UObject* InHandler, FSigSource InSigSrc)
 	{
+		FSigElm* Removed = nullptr;
 		if (auto HandlerFind = In->HandlerObjs.Find(InHandler))
 		{
 			for (auto It = HandlerFind->CreateIterator(); It; ++It)
@@ -114,9 +210,7 @@ struct FSignalUtils
 
 				if (Ptr->GetSource() == InSigSrc)
 				{
-					auto Key = Ptr->GetGMPKey();
-					In->AnySrcSigKeys.Remove(Key);
-					In->GetStorageMap().Remove(Key);
+					Removed = Ptr;
 					It.RemoveCurrent();
 					break;
 				}
@@ -134,6 +228,12 @@ struct FSignalUtils
 				In->HandlerObjs.Remove(InHandler);
 			}
 		}
+
+		if (Removed)
+		{
+			In->UnlinkSource(Removed);
+			In->RemoveSlot(Removed);
+		}
 	}
 
 	static UWorld* GetSigSourceWorld(FSigSource InSigSrc)
@@ -163,74 +263,174 @@ public:
 	{
 		ensure(UObjectInitialized());
 		GUObjectArray.AddUObjectDeleteListener(this);
+		PostGCHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FGMPSourceAndHandlerDeleter::FlushRemovedSources);
+		EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FGMPSourceAndHandlerDeleter::FlushRemovedSources);
 	}
 
 	~FGMPSourceAndHandlerDeleter()
 	{
 		ensure(UObjectInitialized());
 		GUObjectArray.RemoveUObjectDeleteListener(this);
+		FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGCHandle);
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
 	}
 
 #if GMP_SIGNALS_MULTI_THREAD_REMOVAL
-	virtual void NotifyUObjectDeleted(const UObjectBase* ObjectBase, int32 Index) override { RouterObjectRemoved(static_cast<const UObject*>(ObjectBase)); }
+	virtual void NotifyUObjectDeleted(const UObjectBase* ObjectBase, int32 Index) override
+	{
+		// most deleted objects never were a source, they are dropped before any lock
+		if (SourceIndices.TestAndClear(Index))
+			RouterObjectRemoved(static_cast<const UObject*>(ObjectBase), false);
+	}
 #else
-	void OnWatchedObjectRemoved(const UObject* Object) { RouterObjectRemoved(Object); }
+	void OnWatchedObjectRemoved(const UObject* Object) { RouterObjectRemoved(Object, false); }
 #endif
-	using FSigStoreSet = TSet<TWeakPtr<FSignalStore>>;
 	void OnUObjectArrayShutdown()
 	{
+		{
+			FScopeLock Lock(&PendingLock);
+			PendingSources.Reset();
+			bHasPending = false;
+		}
 		MessageMappings.Reset();
-		for (auto Ptr : SignalStores)
+		for (auto& Entry : StoreEntries)
 		{
-			FSignalUtils::ShutdownSingal(Ptr);
+			if (Entry.Store)
+				FSignalUtils::ShutdownSingal(Entry.Store);
 		}
 	}
 
-	void RouterObjectRemoved(FSigSource InSigSrc)
+	// may be called from the purge thread, destroyed objects are only recorded here and purged in one batch after GC
+	void RouterObjectRemoved(FSigSource InSigSrc, bool bFlush)
 	{
-#if GMP_SIGNALS_MULTI_THREAD_REMOVAL
-		// FIXME: IsInGarbageCollectorThread()
-		if (!UNLIKELY(IsInGameThread()))
+		if (!InSigSrc.IsValid())
+			return;
+
+		if (IsInGameThread() && !MessageMappings.Contains(InSigSrc))
+		{
+#if WITH_EDITOR
+			GMPSigSources.Remove(InSigSrc);
+#endif
+			return;
+		}
+
+		FRemovedSource Removed{InSigSrc, FWeakObjectPtr(InSigSrc.TryGetUObject())};
 		{
-			GameThreadObjects.Push(*reinterpret_cast<FSigSource**>(&InSigSrc));
+			FScopeLock Lock(&PendingLock);
+			PendingSources.Add(MoveTemp(Removed));
+			bHasPending = true;
 		}
-		else
-#else
+
+		if (bFlush)
+			FlushRemovedSources();
+	}
+
+	FORCEINLINE void FlushIfPending()
+	{
+		if (UNLIKELY(bHasPending.load(std::memory_order_relaxed)))
+			FlushRemovedSources();
+	}
+
+	// sources removed since the last flush are sorted by store so every store is visited once
+	void FlushRemovedSources()
+	{
 		checkSlow(IsInGameThread());
-#endif
+		TArray<FRemovedSource> Removed;
 		{
+			FScopeLock Lock(&PendingLock);
+			Swap(Removed, PendingSources);
+			bHasPending = false;
+		}
+		if (!Removed.Num())
+			return;
+
 #if WITH_EDITOR
-			GMPSigSources.Remove(InSigSrc);
+		for (auto& Elm : Removed)
+			GMPSigSources.Remove(Elm.Source);
 #endif
-			auto RemoveObject = [&](FSigSource InObj) {
-				FSigStoreSet RemovedStores;
-				if (MessageMappings.RemoveAndCopyValue(InObj, RemovedStores))
-				{
-					for (auto It = RemovedStores.CreateIterator(); It; ++It)
-					{
-						if (auto Pin = It->Pin())
-							FSignalUtils::StaticOnObjectRemoved(Pin.Get(), InObj);
-					}
-				}
-			};
 
-#if GMP_SIGNALS_MULTI_THREAD_REMOVAL
-			if (!GameThreadObjects.IsEmpty())
+		struct FStoreRef
+		{
+			FStoreHandle Handle;
+			int32 StoreIndex;
+			int32 RemovedIndex;
+		};
+		TArray<FStoreRef> StoreRefs;
+		for (int32 Idx = 0; Idx < Removed.Num(); ++Idx)
+		{
+			FStoreHandles Handles;
+			if (!MessageMappings.RemoveAndCopyValue(Removed[Idx].Source, Handles))
+				continue;
+			for (FStoreHandle Handle : Handles)
 			{
-				TArray<FSigSource*> Objs;
-				GameThreadObjects.PopAll(Objs);
-				for (FSigSource* a : Objs)
-				{
-					RemoveObject(**reinterpret_cast<FSigSource**>(a));
-				}
+				if (ResolveStore(Handle))
+					StoreRefs.Add(FStoreRef{Handle, GetStoreIndex(Handle), Idx});
 			}
-#endif
-			RemoveObject(InSigSrc);
+		}
+		if (!StoreRefs.Num())
+			return;
+
+		StoreRefs.Sort([](const FStoreRef& Lhs, const FStoreRef& Rhs) { return Lhs.StoreIndex < Rhs.StoreIndex || (Lhs.StoreIndex == Rhs.StoreIndex && Lhs.RemovedIndex < Rhs.RemovedIndex); });
+
+		TArray<FRemovedSource, TInlineAllocator<16>> Batch;
+		for (int32 Begin = 0; Begin < StoreRefs.Num();)
+		{
+			const int32 StoreIndex = StoreRefs[Begin].StoreIndex;
+			int32 End = Begin;
+			Batch.Reset();
+			for (; End < StoreRefs.Num() && StoreRefs[End].StoreIndex == StoreIndex; ++End)
+			{
+				if (End == Begin || StoreRefs[End].RemovedIndex != StoreRefs[End - 1].RemovedIndex)
+					Batch.Add(Removed[StoreRefs[End].RemovedIndex]);
+			}
+
+			// releasing functors of a previous batch may destroy other stores and new ones may take their slots
+			if (FSignalStore* Store = ResolveStore(StoreRefs[Begin].Handle))
+			{
+				auto Holder = Store->AsShared();
+				FSignalUtils::StaticOnObjectsRemoved(Store, Batch);
+			}
+			Begin = End;
 		}
 	}
 
-	TArray<FSignalStore*, TInlineAllocator<32>> SignalStores;
-	TMap<FSigSource, FSigStoreSet> MessageMappings;
+	// stores are referenced by slot and serial, a stale handle never reaches a store reusing the slot
+	using FStoreHandle = uint64;
+	using FStoreHandles = TArray<FStoreHandle, TInlineAllocator<2>>;
+	struct FStoreEntry
+	{
+		FSignalStore* Store = nullptr;
+		uint32 Serial = 0;
+	};
+	TArray<FStoreEntry> StoreEntries;
+	TArray<int32> FreeStoreEntries;
+	TMap<FSigSource, FStoreHandles> MessageMappings;
+
+	static FORCEINLINE int32 GetStoreIndex(FStoreHandle Handle) { return static_cast<int32>(Handle & MAX_uint32); }
+	FSignalStore* ResolveStore(FStoreHandle Handle) const
+	{
+		const int32 Index = GetStoreIndex(Handle);
+		return (StoreEntries.IsValidIndex(Index) && StoreEntries[Index].Serial == static_cast<uint32>(Handle >> 32)) ? StoreEntries[Index].Store : nullptr;
+	}
+
+	FStoreHandle RegisterStore(FSignalStore* InStore)
+	{
+		const int32 Index = FreeStoreEntries.Num() ? FreeStoreEntries.Pop(false) : StoreEntries.AddDefaulted();
+		auto& Entry = StoreEntries[Index];
+		Entry.Store = InStore;
+		++Entry.Serial;
+		return (static_cast<uint64>(Entry.Serial) << 32) | static_cast<uint32>(Index);
+	}
+
+	void UnregisterStore(FStoreHandle Handle)
+	{
+		const int32 Index = GetStoreIndex(Handle);
+		if (ResolveStore(Handle))
+		{
+			StoreEntries[Index].Store = nullptr;
+			FreeStoreEntries.Add(Index);
+		}
+	}
 
 	static TUniquePtr<FGMPSourceAndHandlerDeleter> GGMPMessageSourceDeleter;
 	static void TryCreate()
@@ -242,11 +442,23 @@ public:
 		}
 	}
 	static FGMPSourceAndHandlerDeleter* TryGet() { return GGMPMessageSourceDeleter.Get(); }
+	// a destroyed address may be reused by a new source, pending removals must be purged before it is used again
+	static FORCEINLINE void FlushPending()
+	{
+		if (auto Deleter = TryGet())
+			Deleter->FlushIfPending();
+	}
 
 	static void AddMessageMapping(FSigSource InSigSrc, FSignalStore* InPtr)
 	{
-		if (InSigSrc.IsValid())
-			TryGet()->MessageMappings.FindOrAdd(InSigSrc).Add(InPtr->AsShared());
+		if (!InSigSrc.IsValid())
+			return;
+		auto Deleter = TryGet();
+		Deleter->MessageMappings.FindOrAdd(InSigSrc).AddUnique(InPtr->StoreHandle);
+#if GMP_SIGNALS_MULTI_THREAD_REMOVAL
+		if (auto Obj = InSigSrc.TryGetUObject())
+			Deleter->SourceIndices.Set(GUObjectArray.ObjectToIndex(Obj));
+#endif
 	}
 
 	static void OnPreExit()
@@ -258,9 +470,15 @@ public:
 		}
 	}
 
+private:
 #if GMP_SIGNALS_MULTI_THREAD_REMOVAL
-	TLockFreePointerListUnordered<FSigSource, PLATFORM_CACHE_LINE_SIZE> GameThreadObjects;
+	FSourceIndexBits SourceIndices;
 #endif
+	FCriticalSection PendingLock;
+	TArray<FRemovedSource> PendingSources;
+	std::atomic<bool> bHasPending{false};
+	FDelegateHandle PostGCHandle;
+	FDelegateHandle EndFrameHandle;
 };
 TUniquePtr<FGMPSourceAndHandlerDeleter> FGMPSourceAndHandlerDeleter::GGMPMessageSourceDeleter;
 
@@ -283,14 +501,14 @@ FSignalStore::FSignalStore()
 	check(IsInGameThread());
 	FGMPSourceAndHandlerDeleter::TryCreate();
 	if (auto Deleter = FGMPSourceAndHandlerDeleter::TryGet())
-		Deleter->SignalStores.Add(this);
+		StoreHandle = Deleter->RegisterStore(this);
 }
 
 FSignalStore::~FSignalStore()
 {
 	check(IsInGameThread());
 	if (auto Deleter = FGMPSourceAndHandlerDeleter::TryGet())
-		Deleter->SignalStores.RemoveSwap(this);
+		Deleter->UnregisterStore(StoreHandle);
 }
 
 TSharedRef<FSignalStore> FSignalImpl::MakeSignals()
@@ -334,7 +552,12 @@ void FSignalImpl::BindSignalConnection(const FSigCollection& Collection, FGMPKey
 
 bool FSignalImpl::IsEmpty() const
 {
-	return Impl()->AnySrcSigKeys.Num() == 0;
+	return Impl()->AnySrcSigElms.Num() == Impl()->AnySrcSigElms.StaleNum;
+}
+
+int32 FSignalImpl::Num() const
+{
+	return Impl()->SigElmMap.Num();
 }
 
 void FSignalImpl::Disconnect()
@@ -349,6 +572,13 @@ void FSignalImpl::Disconnect(FGMPKey Key)
 	FSignalUtils::RemoveSigElm<true>(Impl(), Key);
 }
 
+void FSignalImpl::SetPriority(FGMPKey Key, int32 Priority)
+{
+	checkSlow(IsInGameThread());
+	if (FSigElm* SigElm = Impl()->FindSigElm(Key))
+		Impl()->SetPriority(SigElm, Priority);
+}
+
 void FSignalImpl::Disconnect(const UObject* Listener)
 {
 	checkSlow(IsInGameThread() && Listener);
@@ -373,77 +603,215 @@ void FSignalImpl::DisconnectExactly(const UObject* Listener, FSigSource InSigSrc
 template GMP_API void FSignalImpl::DisconnectExactly<true>(const UObject* Listener, FSigSource InSigSrc);
 template GMP_API void FSignalImpl::DisconnectExactly<false>(const UObject* Listener, FSigSource InSigSrc);
 
+// slots connected during a fire are skipped by it, slots removed during a fire are kept alive until the outermost fire returns
+struct FSignalStore::FFireScope
+{
+	FFireScope(FSignalStore& InStore)
+		: Store(InStore)
+		, Generation(InStore.SlotGeneration)
+	{
+		// connections and priorities changed since the last fire are put in order before this one
+		if (Store.FiringDepth == 0)
+			Store.SortIfDirty();
+		++Store.FiringDepth;
+	}
+	~FFireScope()
+	{
+		// a shutdown while firing has already reset the depth
+		if (Store.FiringDepth > 0 && --Store.FiringDepth == 0)
+		{
+			auto Kills = MoveTemp(Store.PendingKills);
+			Store.CompactBuckets();
+			if (Store.bSlotsUnsorted)
+				Store.SortSlots();
+			else if (Store.StaleSlots > Store.SigElmSlots.Num() / 2)
+				Store.CompactSlots();
+		}
+	}
+	FORCEINLINE bool IsNewer(const FSigElm* SigElm) const { return static_cast<int32>(SigElm->GetGeneration() - Generation) > 0; }
+
+	FSignalStore& Store;
+	const uint32 Generation;
+};
+
+void FSignalUtils::StaticOnObjectsRemoved(FSignalStore* In, TArrayView<const FRemovedSource> Sources)
+{
+	// removals are deferred as during a fire, buckets and slots are compacted once at the end
+	FSignalStore::FFireScope BatchScope(*In);
+	for (auto& Removed : Sources)
+		StaticOnObjectRemoved(In, Removed.Source, Removed.Handler);
+}
+
 template<bool bAllowDuplicate>
-void FSignalImpl::OnFire(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const
+void FSignalImpl::OnFire(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped) const
 {
 	checkSlow(IsInGameThread());
+	FGMPSourceAndHandlerDeleter::FlushPending();
 	GMP_CNOTE_ONCE(Store.IsUnique(), TEXT("maybe unsafe, should avoid reentry."));
 
 	auto StoreHolder = Store;
 	FSignalStore& StoreRef = *StoreHolder;
-	TArray<FGMPKey> CallbackIDs;
-	StoreRef.GetStorageMap().GetKeys(CallbackIDs);
+	FSignalStore::FFireScope FireScope(StoreRef);
 
-	auto CallbackNums = CallbackIDs.Num();
-	FMsgKeyArray EraseIDs;
-	for (auto Idx = 0; Idx < CallbackNums; ++Idx)
+	// slots are appended and never moved while firing
+	const int32 SlotNum = StoreRef.SigElmSlots.Num();
+	for (int32 Idx = 0; Idx < SlotNum && (!bStopped || !*bStopped); ++Idx)
 	{
-		auto ID = CallbackIDs[Idx];
-		auto Elem = StoreRef.FindSigElm(ID);
-		if (!Elem)
-		{
-			EraseIDs.Add(ID);
+		FSigElm* Elem = StoreRef.SigElmSlots[Idx].Get();
+		if (!Elem || FireScope.IsNewer(Elem))
 			continue;
-		}
 
 		switch (Elem->TestInvokable())
 		{
 			case 1:
 				Invoker(Elem);
 			case 0:
-				EraseIDs.Add(ID);
+				if (StoreRef.SigElmSlots[Idx].Get() == Elem)
+					FSignalUtils::RemoveSigElm<bAllowDuplicate>(&StoreRef, Elem->GetGMPKey());
 				break;
 			default:
 				Invoker(Elem);
 				break;
 		}
 	}
-
-	for (auto ID : EraseIDs)
-		FSignalUtils::RemoveSigElm<bAllowDuplicate>(&StoreRef, ID);
 }
-template GMP_API void FSignalImpl::OnFire<true>(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
-template GMP_API void FSignalImpl::OnFire<false>(const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+template GMP_API void FSignalImpl::OnFire<true>(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped) const;
+template GMP_API void FSignalImpl::OnFire<false>(const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped) const;
 
 template<bool bAllowDuplicate>
-FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const
+bool FSignalImpl::OnFireSlot(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const
 {
 	checkSlow(IsInGameThread());
-
 	auto StoreHolder = Store;
 	FSignalStore& StoreRef = *StoreHolder;
+	FSignalStore::FFireScope FireScope(StoreRef);
 
-	// excactly
-	auto CallbackIDs = StoreRef.GetKeysBySrc<FOnFireResultArray>(InSigSrc);
+	FSigElm* Elem = StoreRef.FindSigElm(Key);
+	if (!Elem)
+		return false;
 
-	CallbackIDs.Append(StoreRef.AnySrcSigKeys);
+	switch (Elem->TestInvokable())
+	{
+		case 1:
+			Invoker(Elem);
+		case 0:
+			if (StoreRef.FindSigElm(Key) == Elem)
+				FSignalUtils::RemoveSigElm<bAllowDuplicate>(&StoreRef, Key);
+			break;
+		default:
+			Invoker(Elem);
+			break;
+	}
+	return true;
+}
+template GMP_API bool FSignalImpl::OnFireSlot<true>(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+template GMP_API bool FSignalImpl::OnFireSlot<false>(FGMPKey Key, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
 
-	FMsgKeyArray EraseIDs;
-	for (auto Idx = 0; Idx < CallbackIDs.Num(); ++Idx)
+template<bool bAllowDuplicate>
+FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped, TArrayView<const FSignalImpl* const> Merged) const
+{
+	checkSlow(IsInGameThread());
+	FGMPSourceAndHandlerDeleter::FlushPending();
+
+	// every store fired together is held and deferred alike
+	struct FStoreScope
 	{
-		auto ID = CallbackIDs[Idx];
-		auto Elem = StoreRef.FindSigElm(ID);
-		if (!Elem)
+		FStoreScope(const TSharedPtr<FSignalStore>& InStore)
+			: Holder(InStore)
+			, FireScope(*InStore)
+			, Version(InStore->BucketVersion)
 		{
-			continue;
+		}
+		TSharedPtr<FSignalStore> Holder;
+		FSignalStore::FFireScope FireScope;
+		uint32 Version;
+	};
+	TArray<FStoreScope, TInlineAllocator<2>> Stores;
+	Stores.Reserve(1 + Merged.Num());
+	Stores.Emplace(Store);
+	for (auto Other : Merged)
+	{
+		if (Other && Other->Store.IsValid() && Other->Store != Store)
+			Stores.Emplace(Other->Store);
+	}
+
+#if WITH_EDITOR
+	FOnFireResultArray CallbackIDs;
+	auto SigObj = InSigSrc.TryGetUObject();
+#endif
+
+	// buckets only grow while firing, but SourceObjs may be rehashed by a reentrant connection
+	struct FBucketCursor
+	{
+		int32 StoreIdx;
+		FSigSource Src;
+		const FSignalStore::FSigElmBucket* Bucket;
+		int32 Idx;
+		int32 Num;
+	};
+	TArray<FBucketCursor, TInlineAllocator<3>> Cursors;
+	UWorld* ObjWorld = InSigSrc.SigOrObj() ? FSignalUtils::GetSigSourceWorld(InSigSrc) : nullptr;
+	for (int32 StoreIdx = 0; StoreIdx < Stores.Num(); ++StoreIdx)
+	{
+		auto AddCursor = [&](FSigSource BucketSrc) {
+			if (const FSignalStore::FSigElmBucket* Bucket = Stores[StoreIdx].Holder->FindBucket(BucketSrc))
+				Cursors.Add(FBucketCursor{StoreIdx, BucketSrc, Bucket, 0, Bucket->Num()});
+		};
+
+		// excactly
+		if (InSigSrc.SigOrObj())
+		{
+			AddCursor(InSigSrc);
+			if (ObjWorld)
+				AddCursor(ObjWorld);
+		}
+		AddCursor(FSigSource::NullSigSrc);
+	}
+
+	// buckets are each sorted by priority, merge them and let the earlier bucket win ties
+	while (!bStopped || !*bStopped)
+	{
+		for (int32 StoreIdx = 0; StoreIdx < Stores.Num(); ++StoreIdx)
+		{
+			FStoreScope& Scope = Stores[StoreIdx];
+			if (UNLIKELY(Scope.Version != Scope.Holder->BucketVersion))
+			{
+				Scope.Version = Scope.Holder->BucketVersion;
+				for (auto& Cursor : Cursors)
+				{
+					if (Cursor.StoreIdx == StoreIdx)
+						Cursor.Bucket = Scope.Holder->FindBucket(Cursor.Src);
+				}
+			}
 		}
 
+		FBucketCursor* Next = nullptr;
+		FSigElm* Elem = nullptr;
+		for (auto& Cursor : Cursors)
+		{
+			for (; Cursor.Bucket && Cursor.Idx < Cursor.Num; ++Cursor.Idx)
+			{
+				FSigElm* Candidate = (*Cursor.Bucket)[Cursor.Idx];
+				if (!Candidate || Stores[Cursor.StoreIdx].FireScope.IsNewer(Candidate))
+					continue;
+				if (!Elem || Candidate->GetPriority() > Elem->GetPriority())
+				{
+					Elem = Candidate;
+					Next = &Cursor;
+				}
+				break;
+			}
+		}
+		if (!Elem)
+			break;
+		++Next->Idx;
+
 #if WITH_EDITOR
+		CallbackIDs.Add(Elem->GetGMPKey());
 		auto Listener = Elem->GetHandler();
 		if (!Listener.IsStale(true))
 		{
 			// if mutli world in one process : PIE
-			auto SigObj = InSigSrc.TryGetUObject();
 			if (Listener.Get() && SigObj && Listener.Get()->GetWorld() != SigObj->GetWorld())
 				continue;
 		}
@@ -453,7 +821,7 @@ FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource(FSigSource InSigSrc
 			case 1:
 				Invoker(Elem);
 			case 0:
-				EraseIDs.Add(ID);
+				FSignalUtils::RemoveSigElm<bAllowDuplicate>(Stores[Next->StoreIdx].Holder.Get(), Elem->GetGMPKey());
 				break;
 			default:
 				Invoker(Elem);
@@ -461,62 +829,216 @@ FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource(FSigSource InSigSrc
 		}
 	}
 
-	if (EraseIDs.Num() > 0)
-	{
-		for (auto ID : EraseIDs)
-			FSignalUtils::RemoveSigElm<bAllowDuplicate>(&StoreRef, ID);
-	}
 #if WITH_EDITOR
 	return CallbackIDs;
 #endif
 }
 
-template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<true>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
-template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<false>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker) const;
+template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<true>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped, TArrayView<const FSignalImpl* const> Merged) const;
+template GMP_API FSignalImpl::FOnFireResults FSignalImpl::OnFireWithSigSource<false>(FSigSource InSigSrc, const TGMPFunctionRef<void(FSigElm*)>& Invoker, const bool* bStopped, TArrayView<const FSignalImpl* const> Merged) const;
 
 FSigSource FSigSource::NullSigSrc = FSigSource(nullptr);
 
 void FSigSource::RemoveSource(FSigSource InSigSrc)
 {
 	if (auto Deleter = FGMPSourceAndHandlerDeleter::TryGet())
-		Deleter->RouterObjectRemoved(InSigSrc);
+		Deleter->RouterObjectRemoved(InSigSrc, IsInGameThread());
 }
 
 FSigElm* FSignalStore::FindSigElm(FGMPKey Key) const
 {
-	auto Find = GetStorageMap().Find(Key);
-	const FSigElm* Ret = Find ? Find->Get() : nullptr;
-	return const_cast<FSigElm*>(Ret);
+	return SigElmMap.FindRef(Key);
 }
 
-template<typename ArrayT>
-ArrayT FSignalStore::GetKeysBySrc(FSigSource InSigSrc) const
+void FSignalStore::RemoveSlot(FSigElm* SigElm)
 {
-	ArrayT Results;
-	if (auto Set = SourceObjs.Find(InSigSrc))
+	SigElmMap.Remove(SigElm->GetGMPKey());
+
+	auto& Slot = SigElmSlots[SigElm->SlotIndex];
+	checkSlow(Slot.Get() == SigElm);
+	FSigElmPtr Removed = MoveTemp(Slot);
+	++StaleSlots;
+
+	if (IsFiring())
 	{
-		for (auto Elm : *Set)
+		PendingKills.Add(MoveTemp(Removed));
+	}
+	else if (StaleSlots > SigElmSlots.Num() / 2)
+	{
+		CompactSlots();
+	}
+}
+
+void FSignalStore::UnlinkSource(FSigElm* SigElm)
+{
+	const bool bAnySrc = !SigElm->GetSource().SigOrObj();
+	FSigElmBucket* Bucket = bAnySrc ? &AnySrcSigElms : SourceObjs.Find(SigElm->GetSource());
+	const int32 Idx = SigElm->BucketIndex;
+	if (!Bucket || !Bucket->IsValidIndex(Idx) || (*Bucket)[Idx] != SigElm)
+		return;
+
+	// running fires index the bucket, the entry is left null
+	(*Bucket)[Idx] = nullptr;
+	SigElm->BucketIndex = INDEX_NONE;
+	++Bucket->StaleNum;
+	if (IsFiring())
+	{
+		MarkBucketDirty(SigElm->GetSource());
+	}
+	else if (Bucket->StaleNum > Bucket->Num() / 2)
+	{
+		CompactBucket(*Bucket);
+		if (!bAnySrc && Bucket->Num() == 0)
+			SourceObjs.Remove(SigElm->GetSource());
+	}
+}
+
+void FSignalStore::UnlinkHandler(FSigElm* SigElm)
+{
+	if (auto Find = HandlerObjs.Find(SigElm->GetHandler()))
+	{
+		Find->Remove(SigElm);
+		if (Find->Num() == 0)
+			HandlerObjs.Remove(SigElm->GetHandler());
+	}
+}
+
+void FSignalStore::CompactBucket(FSigElmBucket& Bucket, bool bResort)
+{
+	Bucket.Remove(nullptr);
+	if (bResort)
+		Bucket.StableSort([](const FSigElm& Lhs, const FSigElm& Rhs) { return Lhs.GetPriority() > Rhs.GetPriority(); });
+	Bucket.StaleNum = 0;
+	for (int32 Idx = 0; Idx < Bucket.Num(); ++Idx)
+		Bucket[Idx]->BucketIndex = Idx;
+}
+
+void FSignalStore::CompactBuckets()
+{
+	if (bAnySrcDirty)
+	{
+		bAnySrcDirty = false;
+		CompactBucket(AnySrcSigElms, true);
+	}
+
+	for (auto& Src : DirtyBuckets)
+	{
+		if (auto Bucket = SourceObjs.Find(Src))
 		{
-			Results.Add(Elm->GetGMPKey());
+			CompactBucket(*Bucket, true);
+			if (Bucket->Num() == 0)
+				SourceObjs.Remove(Src);
 		}
 	}
-	Results.Sort();
+	DirtyBuckets.Reset();
+}
 
-	if (UWorld* ObjWorld = FSignalUtils::GetSigSourceWorld(InSigSrc))
+void FSignalStore::CompactSlots()
+{
+	checkSlow(!IsFiring());
+	int32 Count = 0;
+	for (int32 Idx = 0; Idx < SigElmSlots.Num(); ++Idx)
 	{
-		if (const FSigElmPtrSet* Set = SourceObjs.Find(ObjWorld))
+		if (FSigElm* SigElm = SigElmSlots[Idx].Get())
 		{
-			if (Set->Num() > 0)
+			if (Count != Idx)
 			{
-				const auto OldNum = Results.Num();
-				for (auto Elm : *Set)
-				{
-					Results.Add(Elm->GetGMPKey());
-				}
-				std::sort(&Results[OldNum], &Results[OldNum + Set->Num() - 1]);
+				SigElm->SlotIndex = Count;
+				SigElmSlots[Count] = MoveTemp(SigElmSlots[Idx]);
 			}
+			++Count;
 		}
 	}
+	SigElmSlots.SetNum(Count);
+	StaleSlots = 0;
+}
+
+void FSignalStore::SortSlots()
+{
+	checkSlow(!IsFiring());
+	bSlotsUnsorted = false;
+	TArray<FSigElm*> Sorted;
+	Sorted.Reserve(SigElmSlots.Num());
+	for (auto& Slot : SigElmSlots)
+	{
+		if (Slot)
+			Sorted.Add(Slot.Release());
+	}
+	Sorted.StableSort([](const FSigElm& Lhs, const FSigElm& Rhs) { return Lhs.GetPriority() > Rhs.GetPriority(); });
+
+	SigElmSlots.Reset();
+	for (FSigElm* SigElm : Sorted)
+		SigElm->SlotIndex = SigElmSlots.Add(FSigElmPtr(SigElm));
+	StaleSlots = 0;
+}
+
+void FSignalStore::MarkBucketDirty(FSigSource InSigSrc)
+{
+	if (InSigSrc.SigOrObj())
+		DirtyBuckets.AddUnique(InSigSrc);
+	else
+		bAnySrcDirty = true;
+}
+
+void FSignalStore::SortIfDirty()
+{
+	checkSlow(!IsFiring());
+	CompactBuckets();
+	if (bSlotsUnsorted)
+		SortSlots();
+}
+
+void FSignalStore::InsertSorted(FSigElmBucket& Bucket, FSigElm* SigElm)
+{
+	// appended, a priority above the last one sorts the bucket before the next fire
+	const FSigElm* Last = nullptr;
+	for (int32 Cur = Bucket.Num() - 1; Cur >= 0 && !Last; --Cur)
+		Last = Bucket[Cur];
+	SigElm->BucketIndex = Bucket.Add(SigElm);
+	if (Last && Last->GetPriority() < SigElm->GetPriority())
+		MarkBucketDirty(SigElm->GetSource());
+}
+
+void FSignalStore::InsertSortedSlot(FSigElmPtr&& SigElm)
+{
+	const FSigElm* Last = nullptr;
+	for (int32 Cur = SigElmSlots.Num() - 1; Cur >= 0 && !Last; --Cur)
+		Last = SigElmSlots[Cur].Get();
+	if (Last && Last->GetPriority() < SigElm->GetPriority())
+		bSlotsUnsorted = true;
+	SigElm->SlotIndex = SigElmSlots.Num();
+	SigElmSlots.Add(MoveTemp(SigElm));
+}
+
+void FSignalStore::SetPriority(FSigElm* SigElm, int32 Priority)
+{
+	if (SigElm->Priority == Priority)
+		return;
+
+	// many changes between two fires cost one sort
+	SigElm->Priority = Priority;
+	MarkBucketDirty(SigElm->GetSource());
+	bSlotsUnsorted = true;
+}
+
+template<typename ArrayT>
+ArrayT FSignalStore::GetKeysBySrc(FSigSource InSigSrc) const
+{
+	ArrayT Results;
+	auto AppendBucket = [&](FSigSource BucketSrc) {
+		if (auto Bucket = SourceObjs.Find(BucketSrc))
+		{
+			for (auto Elm : *Bucket)
+			{
+				if (Elm)
+					Results.Add(Elm->GetGMPKey());
+			}
+		}
+	};
+
+	AppendBucket(InSigSrc);
+	if (UWorld* ObjWorld = FSignalUtils::GetSigSourceWorld(InSigSrc))
+		AppendBucket(ObjWorld);
 
 	return Results;
 }
@@ -555,12 +1077,15 @@ bool FSignalStore::IsAlive(const UObject* InHandler, FSigSource InSigSrc) const
 
 FSigElm* FSignalStore::AddSigElmImpl(FGMPKey Key, const UObject* InListener, FSigSource InSigSrc, const TGMPFunctionRef<FSigElm*()>& Ctor)
 {
-	auto& Ref = GetStorageMap().FindOrAdd(Key);
-	FSigElm* SigElm = Ref.Get();
+	FGMPSourceAndHandlerDeleter::FlushPending();
+
+	FSigElm* SigElm = SigElmMap.FindRef(Key);
 	if (!SigElm)
 	{
 		SigElm = Ctor();
-		Ref.Reset(SigElm);
+		SigElm->Generation = ++SlotGeneration;
+		InsertSortedSlot(FSigElmPtr(SigElm));
+		SigElmMap.Add(Key, SigElm);
 	}
 
 	if (InListener)
@@ -572,11 +1097,17 @@ FSigElm* FSignalStore::AddSigElmImpl(FGMPKey Key, const UObject* InListener, FSi
 	if (InSigSrc.SigOrObj())
 	{
 		SigElm->Source = InSigSrc;
-		SourceObjs.FindOrAdd(InSigSrc).Add(SigElm);
+		FSigElmBucket* Bucket = SourceObjs.Find(InSigSrc);
+		if (!Bucket)
+		{
+			Bucket = &SourceObjs.Add(InSigSrc);
+			++BucketVersion;
+		}
+		InsertSorted(*Bucket, SigElm);
 	}
 	else
 	{
-		AnySrcSigKeys.Emplace(Key);
+		InsertSorted(AnySrcSigElms, SigElm);
 	}
 	FGMPSourceAndHandlerDeleter::AddMessageMapping(InSigSrc, this);
 
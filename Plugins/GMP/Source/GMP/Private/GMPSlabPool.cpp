@@ -0,0 +1,208 @@
+//  Copyright GenericMessagePlugin, Inc. All Rights Reserved.
+
+#include "GMPFunction.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+namespace GMP
+{
+namespace SlabPool
+{
+	enum : uint32
+	{
+		ChunkSize = 16 * 1024,
+		ClassNum = FGMPSlabPool::kMaxClassSize / FGMPSlabPool::kClassGranularity,
+	};
+
+	struct FFreeBlock
+	{
+		FFreeBlock* Next;
+	};
+
+	// chunks are aligned to their size so a block finds its header by masking the address
+	struct FChunk
+	{
+		FFreeBlock* FreeList;
+		FChunk* Prev;
+		FChunk* Next;
+		int32 LiveNum;
+	};
+	enum : uint32
+	{
+		ChunkHeaderSize = (sizeof(FChunk) + FGMPSlabPool::kClassGranularity - 1) / FGMPSlabPool::kClassGranularity * FGMPSlabPool::kClassGranularity,
+	};
+	FORCEINLINE FChunk* ChunkOf(void* Ptr) { return reinterpret_cast<FChunk*>(UPTRINT(Ptr) & ~UPTRINT(ChunkSize - 1)); }
+
+	struct FSizeClass
+	{
+		FCriticalSection Lock;
+		// chunks with free blocks
+		FChunk* Partial = nullptr;
+		int32 ChunkNum = 0;
+		int32 EmptyNum = 0;
+		int32 LiveNum = 0;
+		int32 HighWater = 0;
+
+		uint32 BlockSize(int32 Index) const { return (Index + 1) * FGMPSlabPool::kClassGranularity; }
+
+		void Link(FChunk* Chunk)
+		{
+			Chunk->Prev = nullptr;
+			Chunk->Next = Partial;
+			if (Partial)
+				Partial->Prev = Chunk;
+			Partial = Chunk;
+		}
+		void Unlink(FChunk* Chunk)
+		{
+			if (Chunk->Prev)
+				Chunk->Prev->Next = Chunk->Next;
+			else
+				Partial = Chunk->Next;
+			if (Chunk->Next)
+				Chunk->Next->Prev = Chunk->Prev;
+		}
+
+		void AddChunk(uint32 InBlockSize)
+		{
+			uint8* Memory = (uint8*)FMemory::Malloc(ChunkSize, ChunkSize);
+			auto Chunk = reinterpret_cast<FChunk*>(Memory);
+			Chunk->FreeList = nullptr;
+			Chunk->LiveNum = 0;
+			for (uint32 Offset = ChunkHeaderSize + ((ChunkSize - ChunkHeaderSize) / InBlockSize) * InBlockSize; Offset > ChunkHeaderSize;)
+			{
+				Offset -= InBlockSize;
+				auto Block = reinterpret_cast<FFreeBlock*>(Memory + Offset);
+				Block->Next = Chunk->FreeList;
+				Chunk->FreeList = Block;
+			}
+			Link(Chunk);
+			++ChunkNum;
+			++EmptyNum;
+		}
+
+		void FreeChunk(FChunk* Chunk)
+		{
+			checkSlow(Chunk->LiveNum == 0);
+			Unlink(Chunk);
+			FMemory::Free(Chunk);
+			--ChunkNum;
+		}
+
+		void ReleaseEmptyChunks()
+		{
+			for (FChunk* Chunk = Partial; Chunk;)
+			{
+				FChunk* Next = Chunk->Next;
+				if (Chunk->LiveNum == 0)
+					FreeChunk(Chunk);
+				Chunk = Next;
+			}
+			EmptyNum = 0;
+		}
+	};
+
+	static FSizeClass& GetClass(int32 Index)
+	{
+		// leaked on purpose, functors may still be freed during static destruction
+		static FSizeClass* Classes = new FSizeClass[ClassNum];
+		return Classes[Index];
+	}
+
+	FORCEINLINE bool IsPooled(uint32 Size, uint32 Alignment) { return Size <= FGMPSlabPool::kMaxClassSize && Alignment <= FGMPSlabPool::kClassGranularity; }
+	FORCEINLINE int32 ClassIndex(uint32 Size) { return (FMath::Max(Size, 1u) - 1) / FGMPSlabPool::kClassGranularity; }
+
+	static FAutoConsoleCommandWithOutputDevice CVar_DumpPoolStats(TEXT("GMP.DumpPoolStats"), TEXT("dump occupancy and high-water marks of the signal element pool"), FConsoleCommandWithOutputDeviceDelegate::CreateStatic(&FGMPSlabPool::DumpStats));
+}  // namespace SlabPool
+
+void* FGMPSlabPool::Malloc(uint32 Size, uint32 Alignment)
+{
+	if (!SlabPool::IsPooled(Size, Alignment))
+		return FMemory::Malloc(Size, Alignment);
+
+	const int32 Index = SlabPool::ClassIndex(Size);
+	auto& Class = SlabPool::GetClass(Index);
+	FScopeLock Lock(&Class.Lock);
+	if (!Class.Partial)
+		Class.AddChunk(Class.BlockSize(Index));
+
+	auto Chunk = Class.Partial;
+	auto Block = Chunk->FreeList;
+	Chunk->FreeList = Block->Next;
+	if (Chunk->LiveNum++ == 0)
+		--Class.EmptyNum;
+	if (!Chunk->FreeList)
+		Class.Unlink(Chunk);
+	Class.HighWater = FMath::Max(Class.HighWater, ++Class.LiveNum);
+	return Block;
+}
+
+void FGMPSlabPool::Free(void* Ptr, uint32 Size, uint32 Alignment)
+{
+	if (!Ptr)
+		return;
+	if (!SlabPool::IsPooled(Size, Alignment))
+		return FMemory::Free(Ptr);
+
+	auto& Class = SlabPool::GetClass(SlabPool::ClassIndex(Size));
+	FScopeLock Lock(&Class.Lock);
+	checkSlow(Class.LiveNum > 0);
+	auto Chunk = SlabPool::ChunkOf(Ptr);
+	if (!Chunk->FreeList)
+		Class.Link(Chunk);
+	auto Block = static_cast<SlabPool::FFreeBlock*>(Ptr);
+	Block->Next = Chunk->FreeList;
+	Chunk->FreeList = Block;
+	--Class.LiveNum;
+
+	// keep one empty chunk per class to avoid thrashing on a single alloc/free pair
+	if (--Chunk->LiveNum == 0)
+	{
+		if (Class.EmptyNum > 0)
+			Class.FreeChunk(Chunk);
+		else
+			++Class.EmptyNum;
+	}
+}
+
+void FGMPSlabPool::ReleaseUnused()
+{
+	for (int32 Index = 0; Index < SlabPool::ClassNum; ++Index)
+	{
+		auto& Class = SlabPool::GetClass(Index);
+		FScopeLock Lock(&Class.Lock);
+		Class.ReleaseEmptyChunks();
+	}
+}
+
+int32 FGMPSlabPool::GetLiveNum()
+{
+	int32 Num = 0;
+	for (int32 Index = 0; Index < SlabPool::ClassNum; ++Index)
+	{
+		auto& Class = SlabPool::GetClass(Index);
+		FScopeLock Lock(&Class.Lock);
+		Num += Class.LiveNum;
+	}
+	return Num;
+}
+
+void FGMPSlabPool::DumpStats(FOutputDevice& Ar)
+{
+	int64 TotalBytes = 0;
+	for (int32 Index = 0; Index < SlabPool::ClassNum; ++Index)
+	{
+		auto& Class = SlabPool::GetClass(Index);
+		FScopeLock Lock(&Class.Lock);
+		if (!Class.ChunkNum && !Class.HighWater)
+			continue;
+
+		const uint32 BlockSize = Class.BlockSize(Index);
+		const int32 Capacity = Class.ChunkNum * ((SlabPool::ChunkSize - SlabPool::ChunkHeaderSize) / BlockSize);
+		TotalBytes += Class.ChunkNum * SlabPool::ChunkSize;
+		Ar.Logf(TEXT("GMPSlabPool [%3u bytes] live %6d / %6d (%5.1f%%) high-water %6d chunks %d empty %d"), BlockSize, Class.LiveNum, Capacity, Capacity ? 100.f * Class.LiveNum / Capacity : 0.f, Class.HighWater, Class.ChunkNum, Class.EmptyNum);
+	}
+	Ar.Logf(TEXT("GMPSlabPool total %lld KB"), TotalBytes / 1024);
+}
+}  // namespace GMP
@@ -136,7 +136,7 @@ inline void Puerts_ListenObjectMessage(const v8::FunctionCallbackInfo<v8::Value>
 				}
 #endif
 
-				auto& Addrs = Body.GetParams();
+				auto Addrs = Body.GetParamsView();
 
 #if GMP_WITH_TYPENAME
 				auto GetTypeName = [&](int32 In) { return Addrs[In].TypeName; };
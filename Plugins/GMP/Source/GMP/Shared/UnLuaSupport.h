@@ -127,7 +127,7 @@ inline int Lua_ListenObjectMessage(lua_State* L)
 					return;
 
 				bool bSucc = true;
-				auto& Addrs = Body.GetParams();
+				auto Addrs = Body.GetParamsView();
 				const int32 NumArgs = Addrs.Num();
 
 				TArray<UnLua::ITypeInterface*, TInlineAllocator<8>> Incs;